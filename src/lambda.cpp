@@ -61,7 +61,8 @@ int main(int argc, char const ** argv)
 
     --until; // undo the "+ 1" above
 
-    if ((std::string(argv[until]) == "searchp") || (std::string(argv[until]) == "searchn"))
+    if ((std::string(argv[until]) == "searchp") || (std::string(argv[until]) == "searchn") ||
+        (std::string(argv[until]) == "servep")  || (std::string(argv[until]) == "serven"))
     {
         return searchMain(argc - until, argv + until);
     }
@@ -87,11 +88,13 @@ ArgumentParser::ParseResult parseCommandLineMain(int argc, char const ** argv)
 
     addArgument(parser, ArgParseArgument(ArgParseArgument::STRING, "COMMAND"));
     setHelpText(parser, 0, "The sub-program to execute. See below.");
-    setValidValues(parser, 0, "searchp searchn mkindexp mkindexn");
+    setValidValues(parser, 0, "searchp searchn servep serven mkindexp mkindexn");
 
     addTextSection(parser, "Available commands");
     addText(parser, "\\fBsearchp  \\fP– Perform a protein search (BLASTP, BLASTX, TBLASTN, TBLASTX).");
     addText(parser, "\\fBsearchn  \\fP– Perform a nucleotide search (BLASTN, MEGABLAST).");
+    addText(parser, "\\fBservep   \\fP– Keep a protein index loaded and answer search jobs received through a socket.");
+    addText(parser, "\\fBserven   \\fP– Keep a nucleotide index loaded and answer search jobs received through a socket.");
     addText(parser, "\\fBmkindexp \\fP– Create an index for protein searches.");
     addText(parser, "\\fBmkindexn \\fP– Create an index for nucleotide searches.");
     addText(parser, "To view the help page for a specific command, simply run 'lambda command --help'.");
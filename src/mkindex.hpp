@@ -236,6 +236,10 @@ realMain(LambdaIndexerOptions     const & options,
     if ((options.alphReduction != 0) || (options.dbIndexType != DbIndexType::SUFFIX_ARRAY))
         dumpTranslatedSeqs(translatedSeqs, options);
 
+    // regions in which hits are discarded when searching
+    if (options.maskLowComplexity || (options.maskKmerCount > 0))
+        dumpSubjMasking(translatedSeqs, options);
+
     // see if final sequence set actually fits into index
     checkIndexSize(translatedSeqs, options, BlastProgramSelector<p>());
 
@@ -284,12 +288,16 @@ realMain(LambdaIndexerOptions     const & options,
     for (auto && s : std::initializer_list<std::pair<std::string, std::string>>
          {
              { options.indexDir + "/option:db_index_type",   std::to_string(static_cast<uint32_t>(options.dbIndexType))},
+             { options.indexDir + "/option:db_storage",      std::string(options.dbMMap ? "mmap" : "alloc") },
+             { options.indexDir + "/option:sa_sampling",     std::to_string(options.saSampling) },
              { options.indexDir + "/option:alph_original",   std::string(_alphTypeToName(OrigSubjAlph<p>())) },
              { options.indexDir + "/option:alph_translated", std::string(_alphTypeToName(TransAlph<p>())) },
              { options.indexDir + "/option:alph_reduced",    std::string(_alphTypeToName(TRedAlph())) },
              { options.indexDir + "/option:genetic_code",    std::to_string(options.geneticCode) },
              { options.indexDir + "/option:subj_seq_len_bits", std::to_string(sizeof(SizeTypePos_<TRedAlph>) * 8)},
              { options.indexDir + "/option:generation",      std::to_string(indexGeneration) },
+             { options.indexDir + "/option:mask_low_complexity", std::string(options.maskLowComplexity ? "on" : "off") },
+             { options.indexDir + "/option:mask_frequent_kmers", std::to_string(options.maskKmerCount) },
          })
     {
         std::ofstream f{std::get<0>(s).c_str(),  std::ios_base::out | std::ios_base::binary};
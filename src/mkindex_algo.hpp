@@ -239,10 +239,9 @@ translateOrSwap(TCDStringSet<String<TTransAlph>> & out,
     double start = sysTime();
     myPrint(options, 1, "Translating Subj Sequences...");
 
-    translate(out,
-              in,
-              SIX_FRAME,
-              options.geneticCode);
+    myTranslateSixFrame(out,
+                        in,
+                        options.geneticCode);
 
     myPrint(options, 1, " done.\n");
     double finish = sysTime() - start;
@@ -279,6 +278,110 @@ dumpTranslatedSeqs(TCDStringSet<String<TTransAlph>> const & translatedSeqs,
     myPrint(options, 2, "Runtime: ", finish, "s \n\n");
 }
 
+// --------------------------------------------------------------------------
+// Function dumpSubjMasking()
+// --------------------------------------------------------------------------
+
+// Compute and store the regions of the subjects in which hits are discarded when searching: low-complexity regions
+// and the positions of k-mers that occur more than options.maskKmerCount times. The regions of every subject are
+// stored as sorted, disjoint intervals [b, e) that are flattened into one string.
+template <typename TTransAlph>
+inline void
+dumpSubjMasking(TCDStringSet<String<TTransAlph>> const & translatedSeqs,
+                LambdaIndexerOptions const & options)
+{
+    double start = sysTime();
+    myPrint(options, 1, "Masking Subj Sequences...");
+
+    // only k-mers of unambiguous residues are counted, i.e. of ACGT or of the 20 standard amino acids (which come first
+    // in the alphabets); there are few enough of them to give every k-mer its own counter, 4^12 or 20^6
+    constexpr bool isDna = std::is_same<TTransAlph, Dna5>::value;
+    constexpr unsigned countedSize = isDna ? 4 : 20;
+    constexpr unsigned k = isDna ? 12 : 6;
+    uint64_t nKmers = 1;
+    for (unsigned j = 0; j < k; ++j)
+        nKmers *= countedSize;
+    uint64_t const nSeqs = length(translatedSeqs);
+
+    // call f(pos, code) for every k-mer of seq that consists of counted residues only
+    auto forEachKmer = [nKmers] (auto const & seq, auto && f)
+    {
+        uint64_t code = 0;
+        unsigned run = 0; // counted residues up to pos
+        for (uint64_t pos = 0; pos < length(seq); ++pos)
+        {
+            unsigned const c = ordValue(seq[pos]);
+            if (c >= countedSize)
+            {
+                run = 0;
+                continue;
+            }
+
+            code = (code * countedSize + c) % nKmers;
+            if (++run >= k)
+                f(pos + 1 - k, code);
+        }
+    };
+
+    std::vector<uint32_t> counts;
+    if (options.maskKmerCount > 0)
+    {
+        counts.assign(nKmers, 0);
+
+        SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 64))
+        for (uint64_t i = 0; i < nSeqs; ++i)
+        {
+            forEachKmer(translatedSeqs[i], [&counts] (uint64_t const, uint64_t const code)
+            {
+                SEQAN_OMP_PRAGMA(atomic)
+                ++counts[code];
+            });
+        }
+    }
+
+    std::vector<String<uint64_t>> intervals(nSeqs);
+    uint64_t nMasked = 0;
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 64) reduction(+:nMasked))
+    for (uint64_t i = 0; i < nSeqs; ++i)
+    {
+        auto const & seq = translatedSeqs[i];
+        std::vector<bool> mask(length(seq), false);
+
+        if (options.maskLowComplexity)
+            maskLowComplexity(seq, mask);
+
+        if (options.maskKmerCount > 0)
+        {
+            forEachKmer(seq, [&] (uint64_t const pos, uint64_t const code)
+            {
+                if (counts[code] > options.maskKmerCount)
+                    std::fill(mask.begin() + pos, mask.begin() + pos + k, true);
+            });
+        }
+
+        for (uint64_t p = 0; p < mask.size(); ++p)
+        {
+            if (mask[p] && ((p == 0) || !mask[p - 1]))
+                appendValue(intervals[i], p);
+            if (mask[p] && ((p + 1 == mask.size()) || !mask[p + 1]))
+                appendValue(intervals[i], p + 1);
+            nMasked += mask[p];
+        }
+    }
+
+    TCDStringSet<String<uint64_t>> masking;
+    for (auto const & iv : intervals)
+        appendValue(masking, iv);
+
+    std::string _path = options.indexDir + "/subj_masking";
+    save(masking, _path.c_str());
+
+    myPrint(options, 1, " done.\n");
+    double finish = sysTime() - start;
+    myPrint(options, 2, "Masked residues: ", nMasked, " of ", lengthSum(translatedSeqs), "\n");
+    myPrint(options, 2, "Runtime: ", finish, "s \n\n");
+}
+
 // --------------------------------------------------------------------------
 // Function loadSubj()
 // --------------------------------------------------------------------------
@@ -778,6 +881,50 @@ createSuffixArray(TSA & SA,
     return createSuffixArray(SA, s, TAlgo());
 }
 
+// ----------------------------------------------------------------------------
+// Function createCompressedSa()
+// ----------------------------------------------------------------------------
+
+// like SeqAn's createCompressedSa(), but with the sampling rate given at run-time instead of TConfig::SAMPLING;
+// locating only follows the indicators, so searching works the same for every rate
+template <typename TText, typename TSpec, typename TConfig, typename TSA, typename TSize>
+void
+createCompressedSa(CompressedSA<TText, TSpec, TConfig> & compressedSA,
+                   TSA const & completeSA,
+                   TSize const offset,
+                   unsigned const samplingRate)
+{
+    typedef CompressedSA<TText, TSpec, TConfig>                     TCompressedSA;
+    typedef typename Fibre<TCompressedSA, FibreSparseString>::Type  TSparseString;
+    typedef typename Fibre<TSparseString, FibreIndicators>::Type    TIndicators;
+    typedef typename Fibre<TSparseString, FibreValues>::Type        TValues;
+    typedef typename Iterator<TSA const, Standard>::Type            TSAIter;
+
+    TSparseString & sparseString    = getFibre(compressedSA, FibreSparseString());
+    TIndicators & indicators        = getFibre(sparseString, FibreIndicators());
+    TValues & values                = getFibre(sparseString, FibreValues());
+
+    resize(compressedSA, length(completeSA) + offset, Exact());
+
+    // the sentinels are never sampled
+    for (TSize pos = 0; pos < offset; ++pos)
+        setValue(indicators, pos, false);
+
+    TSize pos = offset;
+    for (TSAIter saIt = begin(completeSA, Standard()); saIt != end(completeSA, Standard()); ++saIt, ++pos)
+        setValue(indicators, pos, getSeqOffset(getValue(saIt)) % samplingRate == 0);
+
+    updateRanks(indicators);
+
+    resize(values, getRank(indicators, length(sparseString) - 1), Exact());
+
+    TSize counter = 0;
+    pos = offset;
+    for (TSAIter saIt = begin(completeSA, Standard()); saIt != end(completeSA, Standard()); ++saIt, ++pos)
+        if (getValue(indicators, pos))
+            assignValue(values, counter++, getValue(saIt));
+}
+
 // ----------------------------------------------------------------------------
 // Function indexCreate
 // ----------------------------------------------------------------------------
@@ -857,7 +1004,7 @@ indexCreateProgress(Index<TText, FMIndex<TSpec, TConfig> > & index,
     // Create the sampled SA.
     s = sysTime();
     TSize numSentinel = countSequences(text);
-    createCompressedSa(indexSA(index), tempSA, numSentinel);
+    createCompressedSa(indexSA(index), tempSA, numSentinel, options.saSampling);
     double sampleTime = sysTime() - s;
 
     if (options.verbosity >= 1)
@@ -49,6 +49,9 @@ struct LambdaIndexerOptions : public SharedOptions
 
     bool            truncateIDs;
 
+    bool            maskLowComplexity = false;
+    unsigned        maskKmerCount = 0; // 0 = off
+
     int alphReduction;
 
     LambdaIndexerOptions()
@@ -148,6 +151,14 @@ parseCommandLine(LambdaIndexerOptions & options, int argc, char const ** argv)
     setDefaultValue(parser, "db-index-type", "fm");
     setAdvanced(parser, "db-index-type");
 
+    addOption(parser, ArgParseOption("", "db-storage",
+        "How searches load this index by default: \"alloc\" reads it into memory, \"mmap\" maps it so that "
+        "several lambda processes on one host share it via the page cache (can be overridden when searching).",
+        ArgParseArgument::STRING));
+    setValidValues(parser, "db-storage", "alloc mmap");
+    setDefaultValue(parser, "db-storage", "alloc");
+    setAdvanced(parser, "db-storage");
+
     addOption(parser, ArgParseOption("", "truncate-ids",
         "Truncate IDs at first whitespace. This saves a lot of space and is irrelevant for all LAMBDA output formats "
         "other than BLAST Pairwise (.m0).",
@@ -193,6 +204,31 @@ parseCommandLine(LambdaIndexerOptions & options, int argc, char const ** argv)
     setDefaultValue(parser, "algorithm", "radixsort");
     setAdvanced(parser, "algorithm");
 
+    addOption(parser, ArgParseOption("", "sa-sampling",
+        "Every n-th text position is kept in the suffix array of FM indexes. Smaller values make locating hits "
+        "faster, but the index larger.",
+        ArgParseArgument::INTEGER));
+    setDefaultValue(parser, "sa-sampling", "10");
+    setMinValue(parser, "sa-sampling", "1");
+    setMaxValue(parser, "sa-sampling", "256");
+    setAdvanced(parser, "sa-sampling");
+
+    addSection(parser, "Masking");
+    addOption(parser, ArgParseOption("", "mask-low-complexity",
+        "Mask low-complexity regions of the database (SEG for protein, DUST for nucleotide sequences); hits that "
+        "start inside masked regions are discarded when searching.",
+        ArgParseArgument::BOOL));
+    setDefaultValue(parser, "mask-low-complexity", "off");
+    setAdvanced(parser, "mask-low-complexity");
+
+    addOption(parser, ArgParseOption("", "mask-frequent-kmers",
+        "Mask the positions of k-mers (k = 6 for protein, 12 for nucleotide sequences) that occur more often than "
+        "this in the database; hits that start inside masked regions are discarded when searching (0 -> off).",
+        ArgParseArgument::INTEGER));
+    setDefaultValue(parser, "mask-frequent-kmers", "0");
+    setMinValue(parser, "mask-frequent-kmers", "0");
+    setAdvanced(parser, "mask-frequent-kmers");
+
 #ifdef _OPENMP
     addOption(parser, ArgParseOption("t", "threads",
         "number of threads to run concurrently (ignored if a == skew7ext).",
@@ -279,6 +315,8 @@ parseCommandLine(LambdaIndexerOptions & options, int argc, char const ** argv)
     else
         options.dbIndexType = DbIndexType::FM_INDEX;
 
+    getOptionValue(buffer, parser, "db-storage");
+    options.dbMMap = (buffer == "mmap");
 
     if (options.blastProgram == BlastProgram::BLASTN)
     {
@@ -337,6 +375,10 @@ parseCommandLine(LambdaIndexerOptions & options, int argc, char const ** argv)
         options.algo = "radixsort";
     }
 
+    getOptionValue(options.saSampling, parser, "sa-sampling");
+    getOptionValue(options.maskLowComplexity, parser, "mask-low-complexity");
+    getOptionValue(options.maskKmerCount, parser, "mask-frequent-kmers");
+
     getOptionValue(tmpdir, parser, "tmp-dir");
     setEnv("TMPDIR", tmpdir);
 
@@ -20,6 +20,7 @@
 // ==========================================================================
 
 #include <iostream>
+#include <future>
 
 #include <seqan/basic.h>
 #include <seqan/sequence.h>
@@ -36,7 +37,11 @@
 #include "search_options.hpp"
 #include "search_datastructures.hpp"
 #include "search_misc.hpp"
+#include "search_scheme.hpp"
+#include "search_blocks.hpp"
 #include "search_algo.hpp"
+#include "search_serve.hpp"
+#include "search_memory.hpp"
 
 // forwards
 
@@ -160,8 +165,15 @@ argConv0(LambdaOptions & options)
                              "Either rebuild lambda2 with '-DLAMBDA_LEGACY_PATHS=1' or re-create the index.\n");
 #endif // LAMBDA_LEGACY_PATHS
 
+#ifdef FASTBUILD
+    options.dbMMap = false; // not instantiated to save build time
+#endif
+    if (options.dbIndexType == DbIndexType::SUFFIX_ARRAY)
+        options.dbMMap = false; // only supported for the FM indexes
+
     myPrint(options, 2, "Index properties\n"
                         "  type:                ", _indexEnumToName(options.dbIndexType), "\n",
+                        "  SA sampling rate:    ", options.saSampling, "\n",
                         "  original   alphabet: ", _alphabetEnumToName(options.subjOrigAlphabet), "\n");
     if (_alphabetEnumToName(options.subjOrigAlphabet) == _alphabetEnumToName(options.transAlphabet))
     {
@@ -203,6 +215,10 @@ argConv0(LambdaOptions & options)
     // query file
     if (options.qryOrigAlphabet == AlphabetEnum::DNA4) // means "auto", as dna4 not valid as argument to --query-alphabet
     {
+        if (!options.serverSocket.empty())
+            throw std::invalid_argument("The query alphabet cannot be detected in server mode, please set "
+                                        "--input-alphabet.");
+
         myPrint(options, 1, "Detecting query alphabet... ");
         options.qryOrigAlphabet = detectSeqFileAlphabet(options.queryFile);
         myPrint(options, 1, _alphabetEnumToName(options.qryOrigAlphabet), " detected.\n");
@@ -245,15 +261,23 @@ argConv0(LambdaOptions & options)
     // sizes
     checkRAM(options);
 
-    // make sure output is writable
-    int fd = open(toCString(options.output), O_WRONLY | O_CREAT | O_NOCTTY | O_NONBLOCK, 0600);
-    if (fd < 0)
+    if (!options.serverSocket.empty())
     {
-        throw std::invalid_argument("Output file not writable. Check if the directory exists and you have correct "
-                                    "permissions.");
+        // output is only used to select the format, results are sent through the socket
+        if (endsWith(options.output, ".gz") || endsWith(options.output, ".bz2") || endsWith(options.output, ".bam"))
+            throw std::invalid_argument("Compressed output and BAM are not supported in server mode.");
     } else
     {
-        close(fd); // will be opened again, later
+        // make sure output is writable
+        int fd = open(toCString(options.output), O_WRONLY | O_CREAT | O_NOCTTY | O_NONBLOCK, 0600);
+        if (fd < 0)
+        {
+            throw std::invalid_argument("Output file not writable. Check if the directory exists and you have correct "
+                                        "permissions.");
+        } else
+        {
+            close(fd); // will be opened again, later
+        }
     }
 
     // output format conversion to constexpr
@@ -416,6 +440,23 @@ argConv4(LambdaOptions                        & options,
                                    TScoreExtension());
     else
 #endif // LAMBDA_LEGACY_PATHS
+#ifndef FASTBUILD
+    if (options.dbMMap && (options.dbIndexType == DbIndexType::BI_FM_INDEX))
+        return realMain<BidirectionalIndex<TFMIndexInBi<void, MMap<>>>>(options,
+                                                                        TOutFormat(),
+                                                                        BlastTabularSpecSelector<h>(),
+                                                                        BlastProgramSelector<p>(),
+                                                                        TRedAlph(),
+                                                                        TScoreExtension());
+    else if (options.dbMMap && (options.dbIndexType == DbIndexType::FM_INDEX))
+        return realMain<TFMIndex<void, MMap<>>>(options,
+                                                TOutFormat(),
+                                                BlastTabularSpecSelector<h>(),
+                                                BlastProgramSelector<p>(),
+                                                TRedAlph(),
+                                                TScoreExtension());
+    else
+#endif // FASTBUILD
     if (options.dbIndexType == DbIndexType::BI_FM_INDEX)
         return realMain<BidirectionalIndex<TFMIndexInBi<>>>(options,
                                                             TOutFormat(),
@@ -438,6 +479,197 @@ argConv4(LambdaOptions                        & options,
 #else
 #define TID 0
 #endif
+
+// search all queries currently held by the globalHolder (i.e. the whole file or the current chunk)
+template <typename TLocalHolder,
+          typename TGlobalHolder>
+void
+searchQueries(TGlobalHolder       & globalHolder,
+              LambdaOptions const & options,
+              bool          const   showProgress)
+{
+    uint64_t lastPercent = 0;
+
+    computeQueryBlocks(globalHolder, options);
+
+    std::vector<std::vector<unsigned>> numaNodes;
+    if (options.numaInterleave)
+        numaNodes = numaNodeCpus();
+
+    std::exception_ptr writerError;
+    std::thread writer = myStartWriter(globalHolder, options, writerError);
+
+    SEQAN_OMP_PRAGMA(parallel)
+    {
+        TLocalHolder localHolder(options, globalHolder);
+        bool blockOpen = false;
+
+        // threads are distributed round-robin across the nodes
+        if (numaNodes.size() > 1)
+            numaBindThread(numaNodes[TID % numaNodes.size()]);
+
+        SEQAN_OMP_PRAGMA(for schedule(dynamic))
+        for (uint64_t t = 0; t < localHolder.nBlocks; ++t)
+        {
+            int res = 0;
+
+            if (blockOpen) // records of the previous block
+                myFlushRecords(localHolder, true);
+            uint64_t const block = globalHolder.blockOrder[t];
+            myWaitForOutputWindow(globalHolder, options, block);
+            localHolder.init(block);
+            blockOpen = true;
+
+            // seed
+        #ifdef LAMBDA_MICRO_STATS
+            double buf = sysTime();
+        #endif
+            if (options.doubleIndexing)
+            {
+                res = generateSeeds(localHolder);
+                if (res)
+                    continue;
+
+                res = generateTrieOverSeeds(localHolder);
+                if (res)
+                    continue;
+            }
+        #ifdef LAMBDA_MICRO_STATS
+            localHolder.stats.timeGenSeeds += sysTime() - buf;
+
+            // search
+            buf = sysTime();
+        #endif
+            search(localHolder); //TODO seed refining if iterateMatches gives 0 results
+        #ifdef LAMBDA_MICRO_STATS
+            localHolder.stats.timeSearch += sysTime() - buf;
+        #endif
+
+//             // TODO DEBUG
+//             for (auto const & m : localHolder.matches)
+//                 _printMatch(m);
+
+            // sort
+            if (options.filterPutativeAbundant || options.filterPutativeDuplicates || options.mergePutativeSiblings)
+            {
+            #ifdef LAMBDA_MICRO_STATS
+                buf = sysTime();
+            #endif
+
+                sortMatches(localHolder);
+
+            #ifdef LAMBDA_MICRO_STATS
+                localHolder.stats.timeSort += sysTime() - buf;
+            #endif
+            }
+
+            // extend
+            if (length(localHolder.matches) > 0)
+                res = iterateMatches(localHolder);
+
+            if (res)
+                continue;
+
+            if (showProgress && (TID == 0))
+            {
+                unsigned curPercent = ((t * 50) / localHolder.nBlocks) * 2; // round to even
+                printProgressBar(lastPercent, curPercent);
+            }
+
+        } // implicit thread sync here
+
+        if (blockOpen)
+            myFlushRecords(localHolder, true);
+
+        if (showProgress && (TID == 0))
+            printProgressBar(lastPercent, 100);
+
+        SEQAN_OMP_PRAGMA(critical(statsAdd))
+        {
+            globalHolder.stats += localHolder.stats;
+        }
+    }
+
+    myStopWriter(globalHolder, writer, writerError);
+}
+
+// answer search jobs received through the socket until the server is stopped
+template <typename TLocalHolder,
+          typename TGlobalHolder>
+void
+serveQueries(TGlobalHolder       & globalHolder,
+             LambdaOptions const & options)
+{
+    int const serverFd = openServerSocket(options.serverSocket);
+    myPrint(options, 1, "Waiting for search jobs on ", options.serverSocket, " ...\n");
+
+    QueryChunk<TGlobalHolder> chunk;
+    std::string buffer;
+    uint64_t nJobs = 0;
+
+    for (int clientFd = acceptClient(serverFd); clientFd >= 0; clientFd = acceptClient(serverFd))
+    {
+        double start = sysTime();
+        ++nJobs;
+
+        // the extension mode is chosen per job
+        LambdaOptions jobOptions = options;
+        jobOptions.verbosity = 0;
+
+        FdStreamBuf  outBuf(clientFd);
+        std::ostream out(&outBuf);
+        bool outputOpen = false;
+
+        try
+        {
+            if (!receiveAll(buffer, clientFd))
+                throw QueryException{"Could not receive the query sequences."};
+
+            std::istringstream in(buffer);
+            SeqFileIn infile;
+            size_t const firstChar = buffer.find_first_not_of(" \t\r\n");
+            bool const isFastq = (firstChar != std::string::npos) && (buffer[firstChar] == '@');
+            if (!(isFastq ? open(infile, in, Fastq()) : open(infile, in, Fasta())))
+                throw QueryException{"There was an file system or format error."};
+
+            loadQueryChunk(chunk, infile, jobOptions);
+            if (length(chunk.qrySeqs) == 0)
+                throw QueryException{"Zero sequences submitted."};
+
+            swapQueryChunk(globalHolder, chunk);
+            setAutoExtensionMode(jobOptions, chunk.maxLen);
+            globalHolder.stats.clear();
+
+            myWriteHeader(globalHolder, jobOptions, out);
+            outputOpen = true;
+
+            searchQueries<TLocalHolder>(globalHolder, jobOptions, false);
+
+            myWriteFooter(globalHolder, jobOptions);
+
+            myPrint(options, 1, "Job ", nJobs, ": ", length(globalHolder.qryIds), " queries, ",
+                    globalHolder.stats.hitsFinal, " hits, ", sysTime() - start, "s.\n");
+            if (options.verbosity >= 2)
+                printStats(globalHolder.stats, jobOptions);
+        }
+        catch (std::exception const & e)
+        {
+            std::cerr << "ERROR: Job " << nJobs << " failed: " << e.what() << "\n";
+            if (!outputOpen)
+                out << "# ERROR: " << e.what() << "\n";
+        }
+
+        if (outputOpen)
+            myCloseOutput(globalHolder, jobOptions);
+        out.flush();
+        ::close(clientFd);
+    }
+
+    ::close(serverFd);
+    ::unlink(options.serverSocket.c_str());
+    myPrint(options, 1, "Server stopped after ", nJobs, " jobs.\n");
+}
+
 template <typename TIndexSpec,
           typename TRedAlph,
           typename TScoreExtension,
@@ -463,13 +695,38 @@ realMain(LambdaOptions                        & options,
 
     prepareScoring(globalHolder, options);
 
+    // everything allocated while loading the database is spread across the nodes
+    if (options.numaInterleave && !numaInterleave(true))
+        myPrint(options, 1, "WARNING: Could not set NUMA interleaving, continuing without.\n");
+
     loadSubjects(globalHolder, options);
 
     loadDbIndexFromDisk(globalHolder, options);
 
+    if (options.numaInterleave)
+        numaInterleave(false);
+
+    if (std::is_same<typename TGlobalHolder::TDirectStringTag, MMap<>>::value)
+    {
+        bool lockFailed = false;
+        uint64_t const mapped = adviseMappedDb(options.indexDir, options.dbPrefault, options.dbLock, lockFailed);
+        myPrint(options, 2, "Memory-mapped database: ", mapped / 1024 / 1024, "MB\n\n");
+        if (lockFailed)
+            std::cerr << "WARNING: Could not lock the database in memory, check the limit reported by `ulimit -l`.\n";
+    }
+
+    if (!options.doubleIndexing)
+        initKmerTable(globalHolder, options);
+
+    globalHolder.seedCache.init(options.seedCacheSize);
+
     loadTaxonomy(globalHolder, options);
 
-    loadQuery(globalHolder, options);
+    if (!options.serverSocket.empty())
+        return serveQueries<TLocalHolder>(globalHolder, options);
+
+    SeqFileIn queryFileIn;
+    loadQuery(globalHolder, queryFileIn, options);
 
 
 //     std::cout << "1st Query:\n"
@@ -490,6 +747,8 @@ realMain(LambdaOptions                        & options,
 
     myWriteHeader(globalHolder, options);
 
+    bool const streaming = (options.queryChunkSize > 0);
+
     if (options.doubleIndexing)
     {
         myPrint(options, 1,
@@ -504,6 +763,10 @@ realMain(LambdaOptions                        & options,
                 std::cout << std::endl;
             std::cout << "\033[" << options.threads+2 << "A";
         }
+    } else if (streaming)
+    {
+        myPrint(options, 1, "Searching and extending hits on-line in chunks of ", options.queryChunkSize,
+                " queries...\n");
     } else
     {
         myPrint(options, 1, "Searching and extending hits on-line...progress:\n"
@@ -511,85 +774,51 @@ realMain(LambdaOptions                        & options,
     }
     double start = sysTime();
 
-    uint64_t lastPercent = 0;
+    // the background reader prints nothing, it would interfere with the search's output; it also runs on a single
+    // thread, because the search already keeps options.threads threads busy
+    LambdaOptions readerOptions = options;
+    readerOptions.verbosity = 0;
+    readerOptions.threads = 1;
 
-    SEQAN_OMP_PRAGMA(parallel)
-    {
-        TLocalHolder localHolder(options, globalHolder);
+    QueryChunk<TGlobalHolder> nextChunk;
+    uint64_t nChunks = 0;
+    uint64_t nQueries = 0;
 
-        SEQAN_OMP_PRAGMA(for schedule(dynamic))
-        for (uint64_t t = 0; t < localHolder.nBlocks; ++t)
+    while (true)
+    {
+        // read the next chunk while the current one is searched
+        std::future<void> reader;
+        if (streaming && !atEnd(queryFileIn))
         {
-            int res = 0;
-
-            localHolder.init(t);
-
-            // seed
-        #ifdef LAMBDA_MICRO_STATS
-            double buf = sysTime();
-        #endif
-            if (options.doubleIndexing)
+            reader = std::async(std::launch::async, [&nextChunk, &queryFileIn, &readerOptions] ()
             {
-                res = generateSeeds(localHolder);
-                if (res)
-                    continue;
-
-                res = generateTrieOverSeeds(localHolder);
-                if (res)
-                    continue;
-            }
-        #ifdef LAMBDA_MICRO_STATS
-            localHolder.stats.timeGenSeeds += sysTime() - buf;
-
-            // search
-            buf = sysTime();
-        #endif
-            search(localHolder); //TODO seed refining if iterateMatches gives 0 results
-        #ifdef LAMBDA_MICRO_STATS
-            localHolder.stats.timeSearch += sysTime() - buf;
-        #endif
-
-//             // TODO DEBUG
-//             for (auto const & m : localHolder.matches)
-//                 _printMatch(m);
-
-            // sort
-            if (options.filterPutativeAbundant || options.filterPutativeDuplicates || options.mergePutativeSiblings)
-            {
-            #ifdef LAMBDA_MICRO_STATS
-                buf = sysTime();
+            #ifdef _OPENMP
+                // applies to the parallel regions of translation, masking etc. (a new thread does not inherit it)
+                omp_set_num_threads(readerOptions.threads);
             #endif
+                loadQueryChunk(nextChunk, queryFileIn, readerOptions);
+            });
+        }
 
-                sortMatches(localHolder);
-
-            #ifdef LAMBDA_MICRO_STATS
-                localHolder.stats.timeSort += sysTime() - buf;
-            #endif
-            }
+        searchQueries<TLocalHolder>(globalHolder,
+                                    options,
+                                    !options.doubleIndexing && !streaming && (options.verbosity >= 1));
 
-            // extend
-            if (length(localHolder.matches) > 0)
-                res = iterateMatches(localHolder);
+        ++nChunks;
+        nQueries += length(globalHolder.qryIds);
 
-            if (res)
-                continue;
+        if (streaming)
+            myPrint(options, 1, "  chunk ", nChunks, " done; ", nQueries, " queries searched so far.\n");
 
-            if ((!options.doubleIndexing) && (TID == 0) &&
-                (options.verbosity >= 1))
-            {
-                unsigned curPercent = ((t * 50) / localHolder.nBlocks) * 2; // round to even
-                printProgressBar(lastPercent, curPercent);
-            }
+        if (!reader.valid())
+            break;
 
-        } // implicit thread sync here
+        reader.get(); // rethrows exceptions from the reader
 
-        if ((!options.doubleIndexing) && (TID == 0) && (options.verbosity >= 1))
-            printProgressBar(lastPercent, 100);
+        if (length(nextChunk.qrySeqs) == 0)
+            break;
 
-        SEQAN_OMP_PRAGMA(critical(statsAdd))
-        {
-            globalHolder.stats += localHolder.stats;
-        }
+        swapQueryChunk(globalHolder, nextChunk);
     }
 
     myPrint(options, 1, "\n");
@@ -23,8 +23,10 @@
 #ifndef LAMBDA_SEARCH_ALGO_H_
 #define LAMBDA_SEARCH_ALGO_H_
 
+#include <array>
 #include <type_traits>
 #include <iomanip>
+#include <numeric>
 
 #include <seqan/basic.h>
 #include <seqan/sequence.h>
@@ -153,6 +155,26 @@ void readIndexOptions(LambdaOptions & options)
 
     options.dbIndexType = static_cast<DbIndexType>(b);
 
+    // optional, older indexes don't record the storage
+    if (options.dbStorageFromIndex &&
+        (stat((options.indexDir + "/option:db_storage").c_str(), &path_stat) == 0))
+    {
+        buffer.clear();
+        readIndexOption(buffer, "db_storage", options);
+        options.dbMMap = (buffer == "mmap");
+    }
+
+    // optional, older indexes were always sampled with the default rate
+    if (stat((options.indexDir + "/option:sa_sampling").c_str(), &path_stat) == 0)
+    {
+        buffer.clear();
+        readIndexOption(buffer, "sa_sampling", options);
+        b = 0;
+        if (!lexicalCast(b, buffer))
+            throw IndexException("Could not read the index's suffix array sampling rate.");
+        options.saSampling = b;
+    }
+
     if (options.subjOrigAlphabet != options.transAlphabet)
     {
         buffer.clear();
@@ -195,7 +217,9 @@ checkRAM(LambdaOptions const & options)
 
     sizeIndex = dirSize(toCString(options.indexDir));
 
-    sizeQuery = fileSize(toCString(options.queryFile));
+    // streaming and server mode only hold a small part of the queries in memory at any time
+    if ((options.queryChunkSize == 0) && options.serverSocket.empty())
+        sizeQuery = fileSize(toCString(options.queryFile));
 
     uint64_t requiredRAM = ((sizeIndex + sizeQuery) * 11) / 10; // give it +10% TODO verify
 
@@ -339,6 +363,14 @@ loadSubjects(GlobalDataHolder<TRedAlph, TIndexSpec, TOutFormat, p, h> & globalHo
     myPrint(options, 1, " done.\n");
     myPrint(options, 2, "Runtime: ", finish, "s \n\n");
 
+    // optional, only present if the index was created with masking
+    _dbSeqs = options.indexDir;
+    append(_dbSeqs, "/subj_masking");
+    if (!open(globalHolder.subjMasked, toCString(_dbSeqs), OPEN_RDONLY | OPEN_QUIET))
+        clear(globalHolder.subjMasked);
+    else
+        myPrint(options, 2, "Subject masking: ", lengthSum(globalHolder.subjMasked) / 2, " regions\n\n");
+
     context(globalHolder.outfile).dbName = options.indexDir;
 
     // if subjects where translated, we don't have the untranslated seqs at all
@@ -404,6 +436,83 @@ loadDbIndexFromDisk(TGlobalHolder       & globalHolder,
     }
 }
 
+// --------------------------------------------------------------------------
+// Function initKmerTable()
+// --------------------------------------------------------------------------
+
+// iterators for all k-mers, the code of a k-mer is sum(ordValue(c_j) * sigma^(k-1-j))
+template <typename TGlobalHolder, typename TGoDownTag>
+inline void
+_initKmerTable(std::vector<typename TGlobalHolder::TIndexIt> & table,
+               TGlobalHolder                                 & globalHolder,
+               unsigned                                const   k,
+               TGoDownTag                              const &)
+{
+    using TIndexIt = typename TGlobalHolder::TIndexIt;
+    using TAlph    = typename TGlobalHolder::TRedAlph;
+    uint64_t constexpr sigma = ValueSize<TAlph>::VALUE;
+
+    table.assign(1, TIndexIt(globalHolder.dbIndex));
+    for (unsigned j = 0; j < k; ++j)
+    {
+        std::vector<TIndexIt> next(table.size() * sigma, table[0]);
+
+        SEQAN_OMP_PRAGMA(parallel for schedule(static))
+        for (uint64_t code = 0; code < next.size(); ++code)
+        {
+            next[code] = table[code / sigma];
+            // [k-mers whose prefix does not occur keep the shorter repLength]
+            if (repLength(next[code]) == j)
+                goDown(next[code], static_cast<TAlph>(code % sigma), TGoDownTag());
+        }
+
+        std::swap(table, next);
+    }
+}
+
+// The first characters of every seed are searched without errors (half-exact seeding or the reverse part on
+// bidirectional indexes). The iterators for all k-mers of the reduced alphabet are computed once, so that the
+// search can start at depth k instead of going down from the root, where every step is a cache miss. k is as big as
+// possible while the table stays small.
+template <typename TGlobalHolder>
+void
+initKmerTable(TGlobalHolder       & globalHolder,
+              LambdaOptions const & options)
+{
+    uint64_t constexpr sigma = ValueSize<typename TGlobalHolder::TRedAlph>::VALUE;
+    uint64_t constexpr maxEntries = 1ull << 17;
+
+    auto kFor = [] (uint64_t const exactLength)
+    {
+        unsigned k = 0;
+        for (uint64_t entries = sigma; (entries <= maxEntries) && (k < exactLength); entries *= sigma)
+            ++k;
+        return k;
+    };
+
+    size_t const goExactLength = options.seedHalfExact ? (options.seedLength / 2) : 0;
+    globalHolder.kmerLenFwd = kFor(goExactLength);
+    globalHolder.kmerLenRev = TGlobalHolder::indexIsBiFM ? kFor(options.seedLength - goExactLength) : 0;
+
+    if ((globalHolder.kmerLenFwd == 0) && (globalHolder.kmerLenRev == 0))
+        return;
+
+    myPrint(options, 1, "Computing k-mer table...");
+    double start = sysTime();
+
+    _initKmerTable(globalHolder.kmerItsFwd, globalHolder, globalHolder.kmerLenFwd, Fwd());
+    if (TGlobalHolder::indexIsBiFM)
+        _initKmerTable(globalHolder.kmerItsRev, globalHolder, globalHolder.kmerLenRev, Rev());
+
+    double finish = sysTime() - start;
+    myPrint(options, 1, " done.\n");
+    myPrint(options, 2, "Runtime: ", finish, "s \n",
+            "k-mer length: ", globalHolder.kmerLenFwd,
+            TGlobalHolder::indexIsBiFM ? " (forward), " : "",
+            TGlobalHolder::indexIsBiFM ? std::to_string(globalHolder.kmerLenRev) + " (reverse)" : "",
+            "\n\n");
+}
+
 // --------------------------------------------------------------------------
 // Function loadSTaxIds()
 // --------------------------------------------------------------------------
@@ -487,10 +596,9 @@ loadQueryImplTrans(TCDStringSet<String<TTargetAlph, TSpec1>> & target,
 {
     myPrint(options, 1, "translating...");
     // translate
-    translate(target,
-              source,
-              SIX_FRAME,
-              options.geneticCode);
+    myTranslateSixFrame(target,
+                        source,
+                        options.geneticCode);
 
     // preserve lengths of untranslated sequences
     resize(untransQrySeqLengths,
@@ -567,101 +675,340 @@ loadQueryImplTrans(TCDStringSet<String<TransAlph<BlastProgram::BLASTP>, TSpec1>>
     swap(target, source);
 }
 
-template <BlastTabularSpec h,
-          BlastProgram p,
-          typename TRedAlph,
-          typename TIndexSpec,
-          typename TOutFormat>
-void
-loadQuery(GlobalDataHolder<TRedAlph, TIndexSpec, TOutFormat, p, h>      & globalHolder,
-          LambdaOptions                                                 & options)
+// TODO: after changing this, make options const again
+inline void
+setAutoExtensionMode(LambdaOptions & options, unsigned long const maxLen)
 {
-    using TGH = GlobalDataHolder<TRedAlph, TIndexSpec, TOutFormat, p, h>;
-    double start = sysTime();
+    if (options.extensionMode == LambdaOptions::ExtensionMode::AUTO)
+    {
+        if (maxLen <= 100)
+        {
+        #if defined(SEQAN_SIMD_ENABLED)
+            options.extensionMode = LambdaOptions::ExtensionMode::FULL_SIMD;
+        #else
+            options.extensionMode = LambdaOptions::ExtensionMode::FULL_SERIAL;
+        #endif
+            options.xDropOff = -1;
+            options.filterPutativeAbundant = false;
+            options.filterPutativeDuplicates = false;
+            options.mergePutativeSiblings = false;
+        }
+        else
+        {
+            options.extensionMode = LambdaOptions::ExtensionMode::XDROP;
+        }
+    }
+}
 
-    std::string strIdent = "Loading Query Sequences and Ids...";
-    myPrint(options, 1, strIdent);
+// --------------------------------------------------------------------------
+// Function collapseDuplicateQueries()
+// --------------------------------------------------------------------------
 
-    TCDStringSet<String<OrigQryAlph<p>, typename TGH::TQryTag>> origSeqs;
+// Find queries whose sequences (all frames, and the untranslated sequence if it is kept for SAM/BAM) are identical
+// to those of an earlier query. Only the first of them is searched, the others are chained to it and are given its
+// results when the output is written.
+template <typename TGlobalHolder>
+inline void
+collapseDuplicateQueries(QueryChunk<TGlobalHolder> & chunk)
+{
+    using TGH = TGlobalHolder;
+    uint64_t const nFrames  = qNumFrames(TGH::blastProgram);
+    uint64_t const nQueries = length(chunk.qrySeqs) / nFrames;
+    auto const & limits     = chunk.qrySeqs.limits;
+    auto const concatBegin  = begin(chunk.qrySeqs.concat, Standard());
+
+    std::vector<uint64_t> hashes(nQueries);
+    SEQAN_OMP_PRAGMA(parallel for schedule(static))
+    for (uint64_t q = 0; q < nQueries; ++q)
+    {
+        uint64_t h = 14695981039346656037ull; // FNV-1a
+        for (uint64_t p = limits[q * nFrames]; p < limits[(q + 1) * nFrames]; ++p)
+            h = (h ^ ordValue(chunk.qrySeqs.concat[p])) * 1099511628211ull;
+        hashes[q] = h;
+    }
 
-    try
+    auto sameQuery = [&] (uint64_t const a, uint64_t const b)
+    {
+        uint64_t const lenA = limits[(a + 1) * nFrames] - limits[a * nFrames];
+        uint64_t const lenB = limits[(b + 1) * nFrames] - limits[b * nFrames];
+        if ((lenA != lenB) ||
+            (qIsTranslated(TGH::blastProgram) && (chunk.untransQrySeqLengths[a] != chunk.untransQrySeqLengths[b])) ||
+            !std::equal(concatBegin + limits[a * nFrames], concatBegin + limits[(a + 1) * nFrames],
+                        concatBegin + limits[b * nFrames]))
+            return false;
+        // [only kept for SAM/BAM output of translated queries]
+        return (length(chunk.untranslatedQrySeqs) == 0) ||
+               (chunk.untranslatedQrySeqs[a] == chunk.untranslatedQrySeqs[b]);
+    };
+
+    chunk.qryDupNext.assign(nQueries, TGH::noDuplicate);
+    chunk.qryIsDup.assign(nQueries, false);
+    chunk.nDuplicates = 0;
+
+    // hash -> first and last query of the chain
+    std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> chains;
+    chains.reserve(nQueries);
+    for (uint64_t q = 0; q < nQueries; ++q)
     {
-        SeqFileIn infile(toCString(options.queryFile));
-        myReadRecords(globalHolder.qryIds, origSeqs, infile);
+        auto ins = chains.emplace(hashes[q], std::make_pair(q, q));
+        if (ins.second || !sameQuery(ins.first->second.first, q)) // [hash collisions are searched separately]
+            continue;
+
+        chunk.qryDupNext[ins.first->second.second] = q;
+        ins.first->second.second = q;
+        chunk.qryIsDup[q] = true;
+        ++chunk.nDuplicates;
     }
-    catch(std::exception const & e)
+}
+
+// --------------------------------------------------------------------------
+// Function maskLowComplexityQueries()
+// --------------------------------------------------------------------------
+
+// mark the low-complexity regions of the (translated) queries, seeds are not started inside them
+template <typename TGlobalHolder>
+inline void
+maskLowComplexityQueries(QueryChunk<TGlobalHolder> & chunk)
+{
+    uint64_t const nSeqs = length(chunk.qrySeqs);
+
+    clear(chunk.qryMasked);
+    resize(chunk.qryMasked.concat, length(chunk.qrySeqs.concat), false, Exact());
+    chunk.qryMasked.limits = chunk.qrySeqs.limits;
+
+    uint64_t nMasked = 0;
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 64) reduction(+:nMasked))
+    for (uint64_t i = 0; i < nSeqs; ++i)
     {
-        throw QueryException{"There was an file system or format error."};
+        auto && mask = chunk.qryMasked[i];
+        maskLowComplexity(chunk.qrySeqs[i], mask);
+
+        nMasked += std::count(begin(mask, Standard()), end(mask, Standard()), true);
     }
+    chunk.nMasked = nMasked;
+}
+
+// translate the queries that were read and check the limits of the match type
+template <typename TGlobalHolder, typename TOrigSeqs>
+void
+_finishQueryChunk(QueryChunk<TGlobalHolder>       & chunk,
+                  TOrigSeqs                       & origSeqs,
+                  LambdaOptions             const & options)
+{
+    using TGH = TGlobalHolder;
 
     if (length(origSeqs) == 0)
-    {
-        throw QueryException{"Zero sequences submitted."};
-    }
+        return;
 
     // translate
-    loadQueryImplTrans(globalHolder.qrySeqs,
+    loadQueryImplTrans(chunk.qrySeqs,
                        origSeqs,
-                       globalHolder.untransQrySeqLengths,
+                       chunk.untransQrySeqLengths,
                        options);
 
     // sam and bam need original sequences if translation happened
     if (qIsTranslated(TGH::blastProgram) && (options.outFileFormat > 0) &&
         (options.samBamSeq > 0))
-        std::swap(origSeqs, globalHolder.untranslatedQrySeqs);
-
-    if (TGH::alphReduction)
-        globalHolder.redQrySeqs.limits = globalHolder.qrySeqs.limits;
-
-    double finish = sysTime() - start;
-    myPrint(options, 1, " done.\n");
+        std::swap(origSeqs, chunk.untranslatedQrySeqs);
 
-    unsigned long maxLen = 0ul;
-    for (auto const & s : globalHolder.qrySeqs)
-        if (length(s) > maxLen)
-            maxLen = length(s);
+    for (auto const & s : chunk.qrySeqs)
+        if (length(s) > chunk.maxLen)
+            chunk.maxLen = length(s);
 
-    myPrint(options, 2, "Runtime: ", finish, "s \n",
-            "Number of effective query sequences: ",
-            length(globalHolder.qrySeqs), "\nLongest query sequence: ",
-            maxLen, "\n\n");
-
-    if (length(globalHolder.qrySeqs) >= std::numeric_limits<typename TGH::TMatch::TQId>::max())
+    if (length(chunk.qrySeqs) >= std::numeric_limits<typename TGH::TMatch::TQId>::max())
     {
         throw QueryException{"Too many sequences submitted. The maximum (including frames) is " +
                              std::to_string(std::numeric_limits<typename TGH::TMatch::TQId>::max()) +
                              "."};
     }
 
-    if (maxLen >= std::numeric_limits<typename TGH::TMatch::TPos>::max())
+    if (chunk.maxLen >= std::numeric_limits<typename TGH::TMatch::TPos>::max())
     {
         throw QueryException{"One or more of your query sequences are too long. The maximum length is " +
                              std::to_string(std::numeric_limits<typename TGH::TMatch::TPos>::max()) +
                              "."};
     }
 
-    // TODO: after changing this, make options const again
-    if (options.extensionMode == LambdaOptions::ExtensionMode::AUTO)
+    if (options.collapseDuplicates)
+        collapseDuplicateQueries(chunk);
+
+    if (options.maskQueries)
+        maskLowComplexityQueries(chunk);
+}
+
+// read the next chunk of queries (or all remaining queries if not streaming) and translate them
+template <typename TGlobalHolder>
+void
+loadQueryChunk(QueryChunk<TGlobalHolder>       & chunk,
+               SeqFileIn                       & infile,
+               LambdaOptions             const & options)
+{
+    using TGH = TGlobalHolder;
+
+    TCDStringSet<String<OrigQryAlph<TGH::blastProgram>, typename TGH::TQryTag>> origSeqs;
+
+    chunk.clear();
+
+    try
     {
-        if (maxLen <= 100)
-        {
-        #if defined(SEQAN_SIMD_ENABLED)
-            options.extensionMode = LambdaOptions::ExtensionMode::FULL_SIMD;
-        #else
-            options.extensionMode = LambdaOptions::ExtensionMode::FULL_SERIAL;
-        #endif
-            options.xDropOff = -1;
-            options.filterPutativeAbundant = false;
-            options.filterPutativeDuplicates = false;
-            options.mergePutativeSiblings = false;
-        }
+        myReadRecords(chunk.qryIds,
+                      origSeqs,
+                      infile,
+                      [] (auto const &, uint64_t const) {},
+                      options.queryChunkSize ? options.queryChunkSize : std::numeric_limits<uint64_t>::max());
+    }
+    catch(std::exception const & e)
+    {
+        throw QueryException{"There was an file system or format error."};
+    }
+
+    _finishQueryChunk(chunk, origSeqs, options);
+}
+
+// read all queries, the file is split into parts that are parsed by different threads; returns false if the format
+// does not support this
+template <typename TGlobalHolder>
+bool
+loadQueryChunkParallel(QueryChunk<TGlobalHolder>       & chunk,
+                       LambdaOptions             const & options)
+{
+    using TGH = TGlobalHolder;
+
+    TCDStringSet<String<OrigQryAlph<TGH::blastProgram>, typename TGH::TQryTag>> origSeqs;
+
+    chunk.clear();
+
+    try
+    {
+        if (!myReadRecordsParallel(chunk.qryIds, origSeqs, std::string(toCString(options.queryFile)),
+                                   options.threads))
+            return false;
+    }
+    catch(std::exception const & e)
+    {
+        throw QueryException{"There was an file system or format error."};
+    }
+
+    _finishQueryChunk(chunk, origSeqs, options);
+    return true;
+}
+
+template <BlastTabularSpec h,
+          BlastProgram p,
+          typename TRedAlph,
+          typename TIndexSpec,
+          typename TOutFormat>
+void
+loadQuery(GlobalDataHolder<TRedAlph, TIndexSpec, TOutFormat, p, h>      & globalHolder,
+          SeqFileIn                                                     & infile,
+          LambdaOptions                                                 & options)
+{
+    using TGH = GlobalDataHolder<TRedAlph, TIndexSpec, TOutFormat, p, h>;
+    double start = sysTime();
+
+    std::string strIdent = options.queryChunkSize
+                         ? "Loading first chunk of Query Sequences and Ids..."
+                         : "Loading Query Sequences and Ids...";
+    myPrint(options, 1, strIdent);
+
+    if (!open(infile, toCString(options.queryFile)))
+        throw QueryException{"There was an file system or format error."};
+
+    QueryChunk<TGH> chunk;
+    // parsing in parallel only pays off for larger files; it is not possible when streaming
+    bool const parallel = (options.queryChunkSize == 0) && (options.threads > 1) &&
+                          (fileSize(toCString(options.queryFile)) >= (1ull << 20));
+    if (!parallel || !loadQueryChunkParallel(chunk, options))
+        loadQueryChunk(chunk, infile, options);
+
+    if (length(chunk.qrySeqs) == 0)
+    {
+        throw QueryException{"Zero sequences submitted."};
+    }
+
+    swapQueryChunk(globalHolder, chunk);
+
+    double finish = sysTime() - start;
+    myPrint(options, 1, " done.\n");
+
+    unsigned long const maxLen = chunk.maxLen;
+
+    myPrint(options, 2, "Runtime: ", finish, "s \n",
+            "Number of effective query sequences: ",
+            length(globalHolder.qrySeqs), "\nLongest query sequence: ",
+            maxLen, "\n");
+    if (options.collapseDuplicates)
+        myPrint(options, 2, "Exact duplicates (searched once): ", chunk.nDuplicates, "\n");
+    if (options.maskQueries)
+        myPrint(options, 2, "Masked residues (low complexity): ", chunk.nMasked, "\n");
+    myPrint(options, 2, "\n");
+
+    // [when streaming, the first chunk decides for all following chunks]
+    setAutoExtensionMode(options, maxLen);
+}
+
+// --------------------------------------------------------------------------
+// Function computeQueryBlocks()
+// --------------------------------------------------------------------------
+
+// Split the queries into blocks of similar cost and decide in which order the blocks are searched. The cost of a
+// query is estimated from its residues in all frames plus a constant per frame. Without double-indexing, small
+// queries are merged until a block reaches the target cost, so there are enough blocks to balance the threads,
+// but no block per tiny query. Within every group of blocks that fits into the output window, the most expensive
+// blocks are started first, so that a long query does not keep the other threads waiting at the end.
+template <typename TGlobalHolder>
+inline void
+computeQueryBlocks(TGlobalHolder & globalHolder, LambdaOptions const & options)
+{
+    using TGH = TGlobalHolder;
+    uint64_t const nFrames  = qNumFrames(TGH::blastProgram);
+    uint64_t const nQueries = length(globalHolder.qrySeqs) / nFrames;
+
+    std::vector<uint64_t> costs(nQueries);
+    uint64_t total = 0;
+    for (uint64_t q = 0; q < nQueries; ++q)
+    {
+        costs[q] = 32 * nFrames;
+        if (!globalHolder.qryIsDup.empty() && globalHolder.qryIsDup[q]) // not searched
+            costs[q] = 1;
         else
-        {
-            options.extensionMode = LambdaOptions::ExtensionMode::XDROP;
-        }
+            for (uint64_t f = 0; f < nFrames; ++f)
+                costs[q] += length(globalHolder.qrySeqs[q * nFrames + f]);
+        total += costs[q];
     }
+
+    std::vector<uint64_t> queryLimits;
+    if (options.doubleIndexing)
+    {
+        // the number of blocks is given
+        queryLimits = splitQueryBlocks(costs, options.queryPart);
+    } else
+    {
+        // the SIMD extension profits from bigger blocks, because more alignments can be batched; the serial full
+        // extension writes one record per block (see iterateMatchesFullSerial()), so every query is a block there
+        uint64_t const blocksPerThread = (options.extensionMode == LambdaOptions::ExtensionMode::FULL_SIMD) ? 16 : 64;
+        uint64_t const target = (options.extensionMode == LambdaOptions::ExtensionMode::FULL_SERIAL)
+                                ? 0
+                                : std::max<uint64_t>(1, total / (options.threads * blocksPerThread));
+        queryLimits = mergeQueryBlocks(costs, target);
+    }
+
+    auto & limits = globalHolder.blockLimits;
+    limits.resize(queryLimits.size());
+    for (uint64_t b = 0; b < queryLimits.size(); ++b)
+        limits[b] = queryLimits[b] * nFrames;
+
+    uint64_t const nBlocks = queryLimits.size() - 1;
+    std::vector<uint64_t> blockCosts(nBlocks, 0);
+    for (uint64_t b = 0; b < nBlocks; ++b)
+        for (uint64_t q = queryLimits[b]; q < queryLimits[b + 1]; ++q)
+            blockCosts[b] += costs[q];
+
+    // blocks may only be reordered within a group, otherwise threads would wait for the writer
+    globalHolder.blockOrder = orderQueryBlocks(blockCosts, myOutputWindow(options) / 2);
 }
 
+
 /// THREAD LOCAL STUFF
 
 // --------------------------------------------------------------------------
@@ -687,6 +1034,10 @@ generateSeeds(TLocalHolder & lH)
     double start = sysTime();
     for (unsigned long i = lH.indexBeginQry; i < lH.indexEndQry; ++i)
     {
+        // exact duplicates are not searched, they get the results of the first query with the same sequence
+        if (!lH.gH.qryIsDup.empty() && lH.gH.qryIsDup[i / qNumFrames(TLocalHolder::TGlobalHolder::blastProgram)])
+            continue;
+
         for (unsigned j = 0;
              (j* lH.options.seedOffset + lH.options.seedLength)
                 <= length(value(lH.gH.redQrySeqs, i));
@@ -760,20 +1111,21 @@ generateTrieOverSeeds(TLocalHolder & lH)
     return 0;
 }
 
-// perform a fast local alignment score calculation on the seed and see if we
-// reach above threshold
-// WARNING the following function only works for hammingdistanced seeds
+// the region around a seed that is evaluated by the pre-scoring
 template <typename TGlobalHolder,
           typename TScoreExtension>
-inline bool
-seedLooksPromising(LocalDataHolder<TGlobalHolder, TScoreExtension> const & lH,
-                   typename TGlobalHolder::TMatch const & m)
+inline void
+_preScoringRegion(LocalDataHolder<TGlobalHolder, TScoreExtension> const & lH,
+                  typename TGlobalHolder::TMatch const & m,
+                  int64_t & effectiveQBegin,
+                  int64_t & effectiveSBegin,
+                  uint64_t & effectiveLength)
 {
-    int64_t effectiveQBegin = m.qryStart;
-    int64_t effectiveSBegin = m.subjStart;
-    uint64_t actualLength = m.qryEnd - m.qryStart;
-    uint64_t effectiveLength = std::max(static_cast<uint64_t>(lH.options.seedLength * lH.options.preScoring),
-                                        actualLength);
+    effectiveQBegin = m.qryStart;
+    effectiveSBegin = m.subjStart;
+    uint64_t actualLength = m.length;
+    effectiveLength = std::max(static_cast<uint64_t>(lH.options.seedLength * lH.options.preScoring),
+                               actualLength);
 
     if (effectiveLength > actualLength)
     {
@@ -793,6 +1145,21 @@ seedLooksPromising(LocalDataHolder<TGlobalHolder, TScoreExtension> const & lH,
                             static_cast<uint64_t>(length(lH.gH.subjSeqs[m.subjId]) - effectiveSBegin),
                             effectiveLength});
     }
+}
+
+// perform a fast local alignment score calculation on the seed and see if we
+// reach above threshold
+// WARNING the following function only works for hammingdistanced seeds
+template <typename TGlobalHolder,
+          typename TScoreExtension>
+inline bool
+seedLooksPromising(LocalDataHolder<TGlobalHolder, TScoreExtension> const & lH,
+                   typename TGlobalHolder::TMatch const & m)
+{
+    int64_t effectiveQBegin;
+    int64_t effectiveSBegin;
+    uint64_t effectiveLength;
+    _preScoringRegion(lH, m, effectiveQBegin, effectiveSBegin, effectiveLength);
 
     auto const & qSeq = infix(lH.gH.qrySeqs[m.qryId],
                               effectiveQBegin,
@@ -820,6 +1187,202 @@ seedLooksPromising(LocalDataHolder<TGlobalHolder, TScoreExtension> const & lH,
     return false;
 }
 
+// BLAST-style two-hit test: a hit is only kept if an earlier, non-overlapping hit of the same query lies on the same
+// diagonal of the same subject and starts at most twoHitWindow query positions away. The kept match is widened to
+// cover both hits, so the region of the earlier hit is extended, too.
+template <typename TGlobalHolder,
+          typename TScoreExtension>
+inline bool
+twoHitPasses(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH,
+             typename TGlobalHolder::TMatch & m)
+{
+    using TMatch = typename TGlobalHolder::TMatch;
+    using TPos   = typename TMatch::TPos;
+
+    int64_t const diag = m.diagonal();
+    TMatch * const last = lH.twoHitLast.findOrInsert(m);
+    if (last == nullptr)
+        return false;
+
+    auto & prev = *last;
+    bool const overlaps = (prev.qryStart < m.qryEnd()) && (m.qryStart < prev.qryEnd());
+    TPos const dist = (m.qryStart > prev.qryStart) ? (m.qryStart - prev.qryStart) : (prev.qryStart - m.qryStart);
+
+    if (overlaps) // same hit found again, keep the older one as anchor
+        return false;
+
+    if (dist > lH.options.twoHitWindow) // too far away, start anew
+    {
+        prev = m;
+        return false;
+    }
+
+    TPos const qryStart = std::min(prev.qryStart, m.qryStart);
+    TPos const qryEnd   = std::max(prev.qryEnd(), m.qryEnd());
+    prev = m;
+
+    m.qryStart  = qryStart;
+    m.subjStart = static_cast<TPos>(qryStart + diag);
+    m.length    = qryEnd - qryStart;
+    return true;
+}
+
+// Does the same as seedLooksPromising() for all hits in lH.preScoreCands at once and hands the promising ones on. Every
+// candidate is a lane of the inner loops, which read query and subject residues and look up their score directly,
+// so that the compiler can vectorise them and the cache misses of all candidates overlap. The diagonals are scored in
+// chunks of positions; after each chunk the lanes that reached their threshold or their end are retired, which is the
+// early exit of the scalar version.
+template <typename TGlobalHolder,
+          typename TScoreExtension>
+inline void
+preScoreBatch(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
+{
+    using TAlph = TransAlph<TGlobalHolder::blastProgram>;
+    constexpr unsigned alphSize = ValueSize<TAlph>::VALUE;
+    constexpr int8_t padScore = -127; // resets the score, so positions past a lane's end never contribute
+    constexpr uint64_t chunkLength = 8;
+
+    size_t const nCands = lH.preScoreCands.size();
+    if (nCands == 0)
+        return;
+
+    if (lH.preScoreTable.empty())
+    {
+        lH.preScoreTable.resize(alphSize * alphSize);
+        for (unsigned a = 0; a < alphSize; ++a)
+            for (unsigned b = 0; b < alphSize; ++b)
+                lH.preScoreTable[a * alphSize + b] =
+                    std::max(std::min(score(seqanScheme(context(lH.gH.outfile).scoringScheme),
+                                            TAlph(static_cast<uint8_t>(a)),
+                                            TAlph(static_cast<uint8_t>(b))),
+                                      127),
+                             -127);
+    }
+
+    // set up the lanes
+    lH.preScorePassed.assign(nCands, 0);
+    lH.preScoreQry.resize(nCands);
+    lH.preScoreSubj.resize(nCands);
+    lH.preScoreLen.resize(nCands);
+    lH.preScoreThresh.resize(nCands);
+    lH.preScoreLane.resize(nCands);
+    lH.preScoreCur.assign(nCands, 0);
+    lH.preScoreMax.assign(nCands, 0);
+
+    size_t nLanes = 0;
+    for (size_t c = 0; c < nCands; ++c)
+    {
+        auto const & m = lH.preScoreCands[c];
+        int64_t qBegin;
+        int64_t sBegin;
+        uint64_t len;
+        _preScoringRegion(lH, m, qBegin, sBegin, len);
+        if (len == 0)
+            continue;
+
+        lH.preScoreQry[nLanes]    = lH.gH.qrySeqs.limits[m.qryId] + qBegin;
+        lH.preScoreSubj[nLanes]   = lH.gH.subjSeqs.limits[m.subjId] + sBegin;
+        lH.preScoreLen[nLanes]    = len;
+        lH.preScoreThresh[nLanes] = lH.options.preScoringThresh * len;
+        lH.preScoreLane[nLanes]   = c;
+        ++nLanes;
+    }
+
+    auto const qSeqs       = begin(concat(lH.gH.qrySeqs), Standard());
+    auto const sSeqs       = begin(concat(lH.gH.subjSeqs), Standard());
+    int8_t const * const table = lH.preScoreTable.data();
+    uint64_t * const qry   = lH.preScoreQry.data();
+    uint64_t * const subj  = lH.preScoreSubj.data();
+    uint64_t * const len   = lH.preScoreLen.data();
+    int32_t * const thresh = lH.preScoreThresh.data();
+    int32_t * const cur    = lH.preScoreCur.data();
+    int32_t * const best   = lH.preScoreMax.data();
+    uint32_t * const lane  = lH.preScoreLane.data();
+
+    // score the diagonals
+    for (uint64_t j = 0; nLanes > 0; j += chunkLength)
+    {
+        uint64_t const minLength = *std::min_element(len, len + nLanes);
+        if (j + chunkLength <= minLength) // no lane ends inside this chunk
+        {
+            for (uint64_t k = j; k < j + chunkLength; ++k)
+            {
+                for (size_t l = 0; l < nLanes; ++l)
+                {
+                    cur[l] = std::max(cur[l] + table[ordValue(qSeqs[qry[l] + k]) * alphSize +
+                                                     ordValue(sSeqs[subj[l] + k])],
+                                      0);
+                    best[l] = std::max(best[l], cur[l]);
+                }
+            }
+        }
+        else
+        {
+            for (uint64_t k = j; k < j + chunkLength; ++k)
+            {
+                for (size_t l = 0; l < nLanes; ++l)
+                {
+                    int32_t const s = (k < len[l]) ? table[ordValue(qSeqs[qry[l] + k]) * alphSize +
+                                                           ordValue(sSeqs[subj[l] + k])]
+                                                   : padScore;
+                    cur[l] = std::max(cur[l] + s, 0);
+                    best[l] = std::max(best[l], cur[l]);
+                }
+            }
+        }
+
+        // retire lanes that are decided, the last lane takes their place
+        for (size_t l = 0; l < nLanes; /* below */)
+        {
+            bool const passed = best[l] >= thresh[l];
+            if (!passed && (len[l] > j + chunkLength))
+            {
+                ++l;
+                continue;
+            }
+
+            lH.preScorePassed[lane[l]] = passed;
+            --nLanes;
+            qry[l]    = qry[nLanes];
+            subj[l]   = subj[nLanes];
+            len[l]    = len[nLanes];
+            thresh[l] = thresh[nLanes];
+            cur[l]    = cur[nLanes];
+            best[l]   = best[nLanes];
+            lane[l]   = lane[nLanes];
+        }
+    }
+
+    for (size_t c = 0; c < nCands; ++c)
+    {
+        auto & m = lH.preScoreCands[c];
+
+        if (!lH.preScorePassed[c])
+            ++lH.stats.hitsFailedPreExtendTest;
+        else if ((lH.options.twoHitWindow > 0) && !twoHitPasses(lH, m))
+            ++lH.stats.hitsFailedTwoHitTest;
+        else
+            lH.matches.emplace_back(m);
+    }
+
+    lH.preScoreCands.clear();
+}
+
+// whether the hit starts inside a masked region of the subject (see dumpSubjMasking()); the intervals are flattened,
+// so the position is inside one iff an odd number of interval borders are at or before it
+template <typename TGlobalHolder>
+inline bool
+_subjMasked(TGlobalHolder const & gH, typename TGlobalHolder::TMatch const & m)
+{
+    if (empty(gH.subjMasked))
+        return false;
+
+    auto const & borders = gH.subjMasked[m.subjId];
+    auto const it = std::upper_bound(begin(borders, Standard()), end(borders, Standard()),
+                                     static_cast<uint64_t>(m.subjStart));
+    return ((it - begin(borders, Standard())) % 2) == 1;
+}
+
 // --------------------------------------------------------------------------
 // Function onFind()
 // --------------------------------------------------------------------------
@@ -848,17 +1411,26 @@ onFind(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH,
     TMatch m {static_cast<typename TMatch::TQId>(lH.seedRefs[seedId]),
               static_cast<typename TMatch::TSId>(getSeqNo(subjOcc)),
               static_cast<typename TMatch::TPos>(lH.seedRanks[seedId] * lH.options.seedOffset),
-              static_cast<typename TMatch::TPos>(lH.seedRanks[seedId] * lH.options.seedOffset + lH.options.seedLength),
               static_cast<typename TMatch::TPos>(getSeqOffset(subjOcc)),
-              static_cast<typename TMatch::TPos>(getSeqOffset(subjOcc) + lH.options.seedLength)};
+              static_cast<typename TMatch::TPos>(lH.options.seedLength)};
 
     bool discarded = false;
 
-     if (!seedLooksPromising(lH, m))
+     if (_subjMasked(lH.gH, m))
+     {
+         discarded = true;
+         ++lH.stats.hitsMasked;
+     }
+     else if (!seedLooksPromising(lH, m))
      {
          discarded = true;
          ++lH.stats.hitsFailedPreExtendTest;
      }
+     else if ((lH.options.twoHitWindow > 0) && !twoHitPasses(lH, m))
+     {
+         discarded = true;
+         ++lH.stats.hitsFailedTwoHitTest;
+     }
 
     if (!discarded)
         lH.matches.emplace_back(m);
@@ -884,17 +1456,22 @@ onFindVariable(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH,
     TMatch m {seedId,
               static_cast<typename TGlobalHolder::TMatch::TSId>(getSeqNo(subjOcc)),
               seedBegin,
-              static_cast<typename TGlobalHolder::TMatch::TPos>(seedBegin + seedLength),
               static_cast<typename TGlobalHolder::TMatch::TPos>(getSeqOffset(subjOcc)),
-              static_cast<typename TGlobalHolder::TMatch::TPos>(getSeqOffset(subjOcc) + seedLength)};
+              seedLength};
 
-    SEQAN_ASSERT_LT(m.qryStart,  m.qryEnd);
-    SEQAN_ASSERT_LT(m.subjStart, m.subjEnd);
+    SEQAN_ASSERT_GT(m.length, 0u);
 
-    if (!seedLooksPromising(lH, m))
-        ++lH.stats.hitsFailedPreExtendTest;
-    else
-        lH.matches.emplace_back(m);
+    if (_subjMasked(lH.gH, m))
+    {
+        ++lH.stats.hitsMasked;
+        return;
+    }
+
+    // pre-scoring happens in batches, see preScoreBatch()
+    constexpr size_t preScoreBatchSize = 64;
+    lH.preScoreCands.emplace_back(m);
+    if (lH.preScoreCands.size() >= preScoreBatchSize)
+        preScoreBatch(lH);
 }
 
 // --------------------------------------------------------------------------
@@ -921,7 +1498,7 @@ __goDownNoErrors(TIndexIt & indexIt,
     reportRunnable(prevIndexIt, true);
 }
 
-//TODO make number of errors configurable
+// one error, more are searched with search schemes (see _searchSingleIndexSchemes())
 template <typename TIndexIt, typename TGoDownTag, typename TNeedleIt, typename TLambda, typename TLambda2>
 inline void
 __goDownErrors(TIndexIt const & indexIt,
@@ -952,20 +1529,276 @@ __goDownErrors(TIndexIt const & indexIt,
         }
     }
 
-    if (contin == 0)
-        reportRunnable(indexIt, false);
-}
+    if (contin == 0)
+        reportRunnable(indexIt, false);
+}
+
+// prefetch the block of the rank dictionary that rank queries at pos read
+template <typename TRankDictionary>
+inline void
+_prefetchRank(TRankDictionary const & dict, uint64_t const pos)
+{
+#if defined(__GNUC__)
+    auto const & ranks = getFibre(dict, FibreRanks());
+    uint64_t const nBlocks = length(ranks);
+    if (nBlocks == 0)
+        return;
+
+    // the blocks are of equal size, so their position is proportional (off by one at most, which is harmless)
+    uint64_t const b = std::min<uint64_t>(static_cast<double>(pos) / length(dict) * nBlocks, nBlocks - 1);
+    __builtin_prefetch(&ranks[b]);
+#else
+    (void)dict;
+    (void)pos;
+#endif
+}
+
+// prefetch the parts of the rank dictionary that the next goDown() on this iterator reads
+template <typename TIndexIt>
+inline void
+_prefetchGoDown(TIndexIt const & /**/)
+{}
+
+template <typename TText, typename TSpec, typename TConfig, typename TIterSpec>
+inline void
+_prefetchGoDown(Iter<Index<TText, FMIndex<TSpec, TConfig>>, VSTree<TopDown<TIterSpec>>> const & indexIt)
+{
+#if defined(__GNUC__)
+    auto const & bwt = getFibre(indexLF(container(indexIt)), FibreBwt());
+    _prefetchRank(bwt, value(indexIt).range.i1);
+    _prefetchRank(bwt, value(indexIt).range.i2);
+#else
+    (void)indexIt;
+#endif
+}
+
+template <typename TText, typename TIndexSpec, typename TIterSpec>
+inline void
+_prefetchGoDown(Iter<Index<TText, BidirectionalIndex<TIndexSpec>>, VSTree<TopDown<TIterSpec>>> const & indexIt)
+{
+    _prefetchGoDown(indexIt.fwdIter);
+    _prefetchGoDown(indexIt.revIter);
+}
+
+// prefetch what locating the suffix array entry at pos reads first: the bit telling whether the entry is sampled and
+// the rank block for the first LF step; uncompressed suffix arrays need no such thing
+template <typename TSA>
+inline void
+_prefetchLocate(TSA const & /**/, uint64_t const /**/)
+{}
+
+template <typename TText, typename TSpec, typename TConfig>
+inline void
+_prefetchLocate(CompressedSA<TText, TSpec, TConfig> const & sa, uint64_t const pos)
+{
+    _prefetchRank(getFibre(getFibre(sa, FibreSparseString()), FibreIndicators()), pos);
+    _prefetchRank(getFibre(getFibre(sa, FibreLF()), FibreBwt()), pos);
+}
+
+// Call onOcc() on the suffix array entries [begin, end) in order; uncompressed suffix arrays are simply read
+template <typename TSA, typename TOnOcc>
+inline void
+__locateBatched(TSA const & sa, uint64_t const begin, uint64_t const end, TOnOcc && onOcc)
+{
+    for (uint64_t j = begin; j < end; ++j)
+        onOcc(sa[j]);
+}
+
+// In a compressed suffix array every locate is a chain of LF steps with a cache miss each. The entries are resolved
+// in batches instead: every round advances each unresolved entry by one LF step and prefetches the indicator word and
+// rank block its next step reads, so the misses of the whole batch are in flight together. An entry retires when it
+// reaches a sampled position; the batch is reported in suffix array order once all of its entries have retired.
+template <typename TText, typename TSpec, typename TConfig, typename TOnOcc>
+inline void
+__locateBatched(CompressedSA<TText, TSpec, TConfig> const & sa,
+                uint64_t const begin,
+                uint64_t const end,
+                TOnOcc && onOcc)
+{
+    typedef typename Value<CompressedSA<TText, TSpec, TConfig>>::Type TSAValue;
+    constexpr uint64_t locateBatchSize = 16;
+
+    auto const & indicators = getFibre(getFibre(sa, FibreSparseString()), FibreIndicators());
+    auto const & values     = getFibre(getFibre(sa, FibreSparseString()), FibreValues());
+    auto const & lf         = getFibre(sa, FibreLF());
+
+    std::array<uint64_t, locateBatchSize> pos;
+    std::array<uint64_t, locateBatchSize> steps;
+    std::array<uint64_t, locateBatchSize> unresolved; // indexes into the batch
+    std::array<TSAValue, locateBatchSize> located;
+
+    for (uint64_t b = begin; b < end; b += locateBatchSize)
+    {
+        uint64_t const n = std::min(locateBatchSize, end - b);
+        for (uint64_t j = 0; j < n; ++j)
+        {
+            pos[j] = b + j;
+            steps[j] = 0;
+            unresolved[j] = j;
+            _prefetchLocate(sa, pos[j]);
+        }
+
+        uint64_t nUnresolved = n;
+        while (nUnresolved > 0)
+        {
+            for (uint64_t k = 0; k < nUnresolved;)
+            {
+                uint64_t const j = unresolved[k];
+                if (getValue(indicators, pos[j]))
+                {
+                    // same as value(sa, b + j), see index_sa_compressed.h
+                    located[j] = posAdd(getValue(values, getRank(indicators, pos[j]) - 1), steps[j]);
+                    unresolved[k] = unresolved[--nUnresolved];
+                }
+                else
+                {
+                    pos[j] = lf(pos[j]);
+                    ++steps[j];
+                    _prefetchLocate(sa, pos[j]);
+                    ++k;
+                }
+            }
+        }
+
+        for (uint64_t j = 0; j < n; ++j)
+            onOcc(located[j]);
+    }
+}
+
+// Locate all occurrences of indexIt and call onOcc() on each, in suffix array order
+template <typename TIndexIt, typename TOnOcc>
+inline void
+_locateBatched(TIndexIt const & indexIt, TOnOcc && onOcc)
+{
+    auto const occs = getOccurrences(indexIt);
+    __locateBatched(host(occs), beginPosition(occs), endPosition(occs), onOcc);
+}
+
+// Go down the first len characters of a batch of seeds without errors. The first kmerLen characters are looked up
+// in the k-mer table (see initKmerTable()), the rest is searched in lock-step and the rank blocks for the next step
+// are prefetched, so every iterator's memory access is in flight while the other iterators are advanced. Afterwards
+// repLength(its[b]) == len iff seed b was found.
+template <typename TIndexIt, typename TGoDownTag, typename TCharAt>
+inline void
+__goDownExactBatch(std::vector<TIndexIt> & its,
+                   TIndexIt const & root,
+                   std::vector<TIndexIt> const & kmerIts,
+                   unsigned const kmerLen,
+                   size_t const nSeeds,
+                   size_t const len,
+                   TGoDownTag const &,
+                   TCharAt && charAt)
+{
+    using TAlph = typename std::decay<decltype(charAt(0, 0))>::type;
+    SEQAN_ASSERT_LEQ(nSeeds, 64u);
+    SEQAN_ASSERT_LEQ(kmerLen, len);
+
+    its.clear();
+    uint64_t alive = 0;
+    for (size_t b = 0; b < nSeeds; ++b)
+    {
+        uint64_t code = 0;
+        for (size_t k = 0; k < kmerLen; ++k)
+            code = code * ValueSize<TAlph>::VALUE + ordValue(charAt(b, k));
+
+        its.push_back(kmerLen ? kmerIts[code] : root);
+        if (repLength(its.back()) == kmerLen)
+        {
+            alive |= 1ull << b;
+            _prefetchGoDown(its.back());
+        }
+    }
+
+    for (size_t k = kmerLen; (k < len) && alive; ++k)
+    {
+        for (size_t b = 0; b < nSeeds; ++b)
+        {
+            if (!(alive & (1ull << b)))
+                continue;
+
+            if (goDown(its[b], charAt(b, k), TGoDownTag()))
+                _prefetchGoDown(its[b]);
+            else
+                alive &= ~(1ull << b);
+        }
+    }
+}
+
+// seeds are not started at unknown characters (protein 'X' or Dna 'N') or inside masked low-complexity regions
+template <typename TGlobalHolder>
+inline bool
+_skipSeedStart(TGlobalHolder const & gH, size_t const i, size_t const pos)
+{
+    if (pos >= length(gH.qrySeqs[i]))
+        return false;
+
+    return (gH.qrySeqs[i][pos] == unknownValue<TransAlph<TGlobalHolder::blastProgram>>()) ||
+           (!empty(gH.qryMasked.concat) && gH.qryMasked[i][pos]);
+}
+
+// continuation policies for __goDownErrors() and __goDownNoErrors(), they are called for every step of a seed
+
+// ADAPTIVE SEEDING: continue while the seed is shorter than the minimum, or as long as the number of occurrences
+// does not drop below the desired number
+struct SeedContinAdaptive
+{
+    static constexpr bool adaptive = true;
+
+    size_t minLength;           // always continue if this is not exceeded
+    size_t desiredOccs = 0;     // set for every seed
+
+    template <typename TIndexIt>
+    inline bool
+    operator()(TIndexIt const & prevIndexIt, TIndexIt const & indexIt, bool const /*hasError*/) const
+    {
+        // always continue if minimum seed length not reached
+        // TODO currently unclear why considering hasError provides no benefit, and why +1 does
+        if (repLength(indexIt) <= minLength)
+            return true;
+        else if (repLength(indexIt) > 2000) // maximum recursion depth
+            return false;
+
+        // always continue if it means not loosing hits
+        if (countOccurrences(indexIt) == countOccurrences(prevIndexIt))
+            return true;
+
+        // do vodoo heuristics to see if this hit is to frequent
+        if (countOccurrences(indexIt) < desiredOccs)
+            return false;
+
+        return true;
+    }
+};
+
+// NON-ADAPTIVE: seeds of fixed length
+struct SeedContinFixed
+{
+    static constexpr bool adaptive = false;
+
+    size_t minLength;
+    size_t desiredOccs = 0;     // unused
+
+    template <typename TIndexIt>
+    inline bool
+    operator()(TIndexIt const & /**/, TIndexIt const & indexIt, bool const /*hasError*/) const
+    {
+        return (repLength(indexIt) <= minLength);
+    }
+};
 
 template <typename TGlobalHolder,
-          typename TScoreExtension>
+          typename TScoreExtension,
+          typename TContin>
 inline void
-_searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
+_searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH, TContin continRunnable)
 {
     typedef typename Iterator<typename TGlobalHolder::TDbIndex, TopDown<> >::Type TIndexIt;
 
     // TODO optionize
     size_t constexpr seedHeurFactor = /*TGlobalHolder::indexIsBiFM ? 5 :*/ 10;
     size_t constexpr minResults = 1;
+    // number of seeds whose exact part is searched in lock-step
+    size_t constexpr seedBatchSize = 16;
 
     size_t needlesSum = 0;
     size_t needlesPos = 0;
@@ -974,7 +1807,8 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
     TIndexIt root(lH.gH.dbIndex);
     TIndexIt indexIt = root;
 
-    std::function<bool(TIndexIt const &, TIndexIt const &, bool const)> continRunnable;
+    std::vector<size_t>   seedBegins;
+    std::vector<TIndexIt> batchIts;
 
     /* It is important to note some option dependencies:
      * lH.options.maxSeedDist == 0 -> lH.options.seedHalfExact == true
@@ -988,12 +1822,28 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
 
     size_t const goExactLength = lH.options.seedHalfExact ? (lH.options.seedLength / 2) : 0;
 
+    // the seeds read at most minLength + 1 characters
+    bool const useCache = !TContin::adaptive && lH.gH.seedCache.enabled();
+    size_t const cacheKeyLength = continRunnable.minLength + 1;
+
+    auto searchRunnable = [&lH, useCache] (auto & reportRunnable)
+    {
+        return [&lH, &reportRunnable, useCache] (auto const & indexIt, bool const hasError)
+        {
+            if (useCache)
+                lH.seedCacheResults.emplace_back(indexIt, hasError);
+            reportRunnable(indexIt, hasError);
+        };
+    };
+
     for (size_t i = lH.indexBeginQry; i < lH.indexEndQry; ++i)
     {
-        if (length(lH.gH.redQrySeqs[i]) < lH.options.seedLength)
+        // exact duplicates are not searched, they get the results of the first query with the same sequence
+        if (!lH.gH.qryIsDup.empty() && lH.gH.qryIsDup[i / qNumFrames(TGlobalHolder::blastProgram)])
             continue;
 
-        size_t desiredOccs      = 0;
+        if (length(lH.gH.redQrySeqs[i]) < lH.options.seedLength)
+            continue;
 
         // the next sequences belong to a new set of query sequences
         if ((i % qNumFrames(TGlobalHolder::blastProgram)) == 0)
@@ -1003,47 +1853,17 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
             // the above is faster anyway (but only works on concatdirect sets)
 
             needlesPos = 0;
+            if (TContin::adaptive) // the match count must be up-to-date
+                preScoreBatch(lH);
             oldTotalMatches = length(lH.matches); // need to subtract matchcount from other queries
         }
 
-        if (lH.options.adaptiveSeeding)
-        {
-            continRunnable = [&lH, &desiredOccs] (auto const & prevIndexIt, auto const & indexIt, bool const/*hasError*/)
-            {
-                // ADAPTIVE SEEDING:
-
-                // always continue if minimum seed length not reached
-                // TODO currently unclear why considering hasError provides no benefit, and why +1 does
-                if (repLength(indexIt) <= (lH.options.seedLength + /*hasError* */ lH.options.seedDeltaIncreasesLength))
-                    return true;
-                else if (repLength(indexIt) > 2000) // maximum recursion depth
-                    return false;
-
-                // always continue if it means not loosing hits
-                if (countOccurrences(indexIt) == countOccurrences(prevIndexIt))
-                    return true;
-
-                // do vodoo heuristics to see if this hit is to frequent
-                if (countOccurrences(indexIt) < desiredOccs)
-                    return false;
-
-                return true;
-            };
-        } else
-        {
-            continRunnable = [&lH] (auto const &, auto const & indexIt, bool const /*hasError*/)
-            {
-                // NON-ADAPTIVE
-                return (repLength(indexIt) <= (lH.options.seedLength +
-                                               /*hasError* */ lH.options.seedDeltaIncreasesLength));
-            };
-        }
-
         /* FORWARD SEARCH */
+        seedBegins.clear();
         for (size_t seedBegin = 0; /* below */; seedBegin += lH.options.seedOffset)
         {
-            // skip proteine 'X' or Dna 'N'
-            while ((lH.gH.qrySeqs[i][seedBegin] == unknownValue<TransAlph<TGlobalHolder::blastProgram>>()) &&
+            // skip proteine 'X' or Dna 'N' and masked regions
+            while (_skipSeedStart(lH.gH, i, seedBegin) &&
                    (seedBegin <= length(lH.gH.redQrySeqs[i]) - lH.options.seedLength))
                 ++seedBegin;
 
@@ -1051,23 +1871,40 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
             if (seedBegin > length(lH.gH.redQrySeqs[i]) - lH.options.seedLength)
                 break;
 
-            indexIt = root;
+            seedBegins.push_back(seedBegin);
+        }
 
-            if (lH.options.adaptiveSeeding)
+        for (size_t b = 0; b < seedBegins.size(); ++b)
+        {
+            // go down some characters without errors if bidirectional or halfExact [a batch of seeds at once]
+            if ((b % seedBatchSize) == 0)
             {
-                desiredOccs = (length(lH.matches) - oldTotalMatches) >= lH.options.maxMatches
-                            ? minResults
-                            : (lH.options.maxMatches - (length(lH.matches) - oldTotalMatches)) * seedHeurFactor /
-                                std::max((needlesSum - needlesPos - seedBegin) / lH.options.seedOffset, static_cast<size_t>(1));
+                __goDownExactBatch(batchIts, root, lH.gH.kmerItsFwd, lH.gH.kmerLenFwd,
+                                   std::min(seedBatchSize, seedBegins.size() - b), goExactLength, Fwd(),
+                                   [&lH, &seedBegins, &i, b] (size_t const j, size_t const k)
+                                   {
+                                       return lH.gH.redQrySeqs[i][seedBegins[b + j] + k];
+                                   });
+            }
+
+            size_t const seedBegin = seedBegins[b];
+            indexIt = batchIts[b % seedBatchSize];
 
-                if (desiredOccs == 0)
-                    desiredOccs = minResults;
+            if (TContin::adaptive)
+            {
+                // the match count must be up-to-date, so the hits of the previous seed are pre-scored now (many of them fail)
+                if (!lH.preScoreCands.empty())
+                    preScoreBatch(lH);
+                size_t const nMatches = length(lH.matches) - oldTotalMatches;
+                continRunnable.desiredOccs = nMatches >= lH.options.maxMatches
+                                           ? minResults
+                                           : (lH.options.maxMatches - nMatches) * seedHeurFactor /
+                                               std::max((needlesSum - needlesPos - seedBegin) / lH.options.seedOffset, static_cast<size_t>(1));
+
+                if (continRunnable.desiredOccs == 0)
+                    continRunnable.desiredOccs = minResults;
             }
 
-            // go down some characters without errors if bidirectional or halfExact
-            for (size_t k = 0; k < goExactLength; ++k)
-                if (!goDown(indexIt, lH.gH.redQrySeqs[i][seedBegin + k]))
-                    break;
             // if unsuccessful, move to next seed
             if (repLength(indexIt) != goExactLength)
                 continue;
@@ -1080,11 +1917,24 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
                     appendValue(lH.stats.seedLengths, repLength(indexIt));
                 #endif
                     lH.stats.hitsAfterSeeding += countOccurrences(indexIt);
-                    for (auto occ : getOccurrences(indexIt))
+                    _locateBatched(indexIt, [&] (auto const & occ)
+                    {
                         onFindVariable(lH, occ, i, seedBegin, repLength(indexIt));
+                    });
                 }
             };
 
+            if (useCache)
+            {
+                lH.seedCacheKey.assign(1, 'F');
+                for (size_t k = seedBegin; k < std::min(seedBegin + cacheKeyLength, length(lH.gH.redQrySeqs[i])); ++k)
+                    lH.seedCacheKey.push_back(ordValue(lH.gH.redQrySeqs[i][k]));
+                if (_seedCacheReplay(lH, reportRunnable))
+                    continue;
+            }
+
+            auto cachingRunnable = searchRunnable(reportRunnable);
+
             if (lH.options.maxSeedDist)
             {
                 __goDownErrors(indexIt,
@@ -1092,7 +1942,7 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
                                begin(lH.gH.redQrySeqs[i], Standard()) + seedBegin + goExactLength,
                                end(lH.gH.redQrySeqs[i], Standard()),
                                continRunnable,
-                               reportRunnable);
+                               cachingRunnable);
             }
             else
                 __goDownNoErrors(indexIt,
@@ -1100,7 +1950,10 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
                                  begin(lH.gH.redQrySeqs[i], Standard()) + seedBegin + goExactLength,
                                  end(lH.gH.redQrySeqs[i], Standard()),
                                  continRunnable,
-                                 reportRunnable);
+                                 cachingRunnable);
+
+            if (useCache)
+                lH.gH.seedCache.insert(lH.seedCacheKey, lH.seedCacheResults);
         }
 
         /* REVERSE SEARCH on BIDIRECTIONAL INDEXES */
@@ -1108,11 +1961,12 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
         {
             using   TRevNeedle      = ModifiedString<decltype(lH.gH.redQrySeqs[0]), ModReverse>;
             TRevNeedle revNeedle{lH.gH.redQrySeqs[i]};
+            seedBegins.clear();
             for (size_t seedBegin = lH.options.seedLength - 1; /* below */; seedBegin += lH.options.seedOffset)
             {
 
-                // skip proteine 'X' or Dna 'N'
-                while ((lH.gH.qrySeqs[i][seedBegin] == unknownValue<TransAlph<TGlobalHolder::blastProgram>>()) &&
+                // skip proteine 'X' or Dna 'N' and masked regions
+                while (_skipSeedStart(lH.gH, i, seedBegin) &&
                     seedBegin < length(lH.gH.redQrySeqs[i]))                 // [different abort condition than above]
                     ++seedBegin;
 
@@ -1120,23 +1974,41 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
                 if (seedBegin >= length(lH.gH.redQrySeqs[i]))                // [different abort condition than above]
                     break;
 
-                indexIt = root;
+                seedBegins.push_back(seedBegin);
+            }
 
-                if (lH.options.adaptiveSeeding)
+            for (size_t b = 0; b < seedBegins.size(); ++b)
+            {
+                // go down seedOffset number of characters without errors [a batch of seeds at once]
+                if ((b % seedBatchSize) == 0)
                 {
-                    desiredOccs = (length(lH.matches) - oldTotalMatches) >= lH.options.maxMatches
-                                ? minResults
-                                : (lH.options.maxMatches - (length(lH.matches) - oldTotalMatches)) * seedHeurFactor /
-                                    std::max((needlesSum - needlesPos - seedBegin) / lH.options.seedOffset, static_cast<size_t>(1));
+                    __goDownExactBatch(batchIts, root, lH.gH.kmerItsRev, lH.gH.kmerLenRev,
+                                       std::min(seedBatchSize, seedBegins.size() - b),
+                                       lH.options.seedLength - goExactLength, Rev(),
+                                       [&lH, &seedBegins, &i, b] (size_t const j, size_t const k)
+                                       {
+                                           return lH.gH.redQrySeqs[i][seedBegins[b + j] - k]; // [- instead of +]
+                                       });
+                }
 
-                    if (desiredOccs == 0)
-                        desiredOccs = minResults;
+                size_t const seedBegin = seedBegins[b];
+                indexIt = batchIts[b % seedBatchSize];
+
+                if (TContin::adaptive)
+                {
+                    // the match count must be up-to-date, so the hits of the previous seed are pre-scored now (many of them fail)
+                    if (!lH.preScoreCands.empty())
+                        preScoreBatch(lH);
+                    size_t const nMatches = length(lH.matches) - oldTotalMatches;
+                    continRunnable.desiredOccs = nMatches >= lH.options.maxMatches
+                                               ? minResults
+                                               : (lH.options.maxMatches - nMatches) * seedHeurFactor /
+                                                   std::max((needlesSum - needlesPos - seedBegin) / lH.options.seedOffset, static_cast<size_t>(1));
+
+                    if (continRunnable.desiredOccs == 0)
+                        continRunnable.desiredOccs = minResults;
                 }
 
-                // go down seedOffset number of characters without errors
-                for (size_t k = 0; k < (lH.options.seedLength - goExactLength); ++k)
-                    if (!goDown(indexIt, lH.gH.redQrySeqs[i][seedBegin - k], Rev())) // [rev and  - instead of fwd]
-                        break;
                 // if unsuccessful, move to next seed
                 if (repLength(indexIt) != (lH.options.seedLength - goExactLength))
                     continue;
@@ -1150,18 +2022,34 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
                         appendValue(lH.stats.seedLengths, repLength(indexIt));
                     #endif
                         lH.stats.hitsAfterSeeding += countOccurrences(indexIt);
-                        for (auto occ : getOccurrences(indexIt))                    // [different start pos]
+                        _locateBatched(indexIt, [&] (auto const & occ)              // [different start pos]
+                        {
                             onFindVariable(lH, occ, i, seedBegin - repLength(indexIt) + 1,  repLength(indexIt));
+                        });
                     }
                 };
 
+                if (useCache)
+                {
+                    lH.seedCacheKey.assign(1, 'R');                          // [characters from right to left]
+                    for (size_t k = 0; (k < cacheKeyLength) && (k <= seedBegin); ++k)
+                        lH.seedCacheKey.push_back(ordValue(lH.gH.redQrySeqs[i][seedBegin - k]));
+                    if (_seedCacheReplay(lH, reportRunnable))
+                        continue;
+                }
+
+                auto cachingRunnable = searchRunnable(reportRunnable);
+
                 // [rev and reverse needle]
                 __goDownErrors(indexIt,
                                Rev(),
                                end(revNeedle, Standard()) - seedBegin + lH.options.seedLength - goExactLength - 1,
                                end(revNeedle, Standard()),
                                continRunnable,
-                               reportRunnable);
+                               cachingRunnable);
+
+                if (useCache)
+                    lH.gH.seedCache.insert(lH.seedCacheKey, lH.seedCacheResults);
 
             }
         }
@@ -1170,6 +2058,343 @@ _searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
     }
 }
 
+// Seeds whose search depends only on the characters they read (not on adaptive seeding's state) are looked up in the
+// seed cache with the key in lH.seedCacheKey; returns true if they were found and their results reported.
+template <typename TLocalHolder, typename TLambda>
+inline bool
+_seedCacheReplay(TLocalHolder & lH, TLambda & reportRunnable)
+{
+    lH.seedCacheResults.clear();
+    if (!lH.gH.seedCache.find(lH.seedCacheKey, lH.seedCacheResults))
+    {
+        ++lH.stats.seedCacheMisses;
+        return false;
+    }
+
+    ++lH.stats.seedCacheHits;
+    for (auto const & r : lH.seedCacheResults)
+        reportRunnable(r.first, r.second);
+    return true;
+}
+
+// SPACED SEEDS
+
+// a seed pattern, positions with care[j] == false match any character
+struct SpacedSeed
+{
+    std::vector<bool>   care;
+    std::vector<size_t> order;  // positions of the pattern in the order in which they are searched
+    size_t              nFwd;   // order[0, nFwd) are searched with Fwd(), the rest with Rev()
+
+    SpacedSeed(std::string const & pattern, bool const bidirectional)
+    {
+        for (char c : pattern)
+            care.push_back(c == '1');
+
+        // on bidirectional indexes start with the longest block of 1s, then extend to the right and to the left,
+        // so that the branching on 0s happens as late as possible
+        size_t anchorBegin = 0;
+        size_t anchorEnd   = bidirectional ? 0 : care.size();
+        for (size_t b = 0; bidirectional && (b < care.size()); )
+        {
+            size_t e = b;
+            while ((e < care.size()) && care[e])
+                ++e;
+            if (e - b > anchorEnd - anchorBegin)
+            {
+                anchorBegin = b;
+                anchorEnd   = e;
+            }
+            b = e + 1;
+        }
+
+        for (size_t j = anchorBegin; j < care.size(); ++j)
+            order.push_back(j);
+        nFwd = order.size();
+        for (size_t j = anchorBegin; j > 0; --j)
+            order.push_back(j - 1);
+    }
+};
+
+template <typename TIndexIt, typename TChar>
+inline bool
+_goDownDir(TIndexIt & indexIt, TChar const c, bool const /*fwd, always true on unidirectional indexes*/)
+{
+    return goDown(indexIt, c, Fwd());
+}
+
+template <typename TText, typename TIndexSpec, typename TIterSpec, typename TChar>
+inline bool
+_goDownDir(Iter<Index<TText, BidirectionalIndex<TIndexSpec>>, VSTree<TopDown<TIterSpec>>> & indexIt,
+           TChar const c,
+           bool const fwd)
+{
+    return fwd ? goDown(indexIt, c, Fwd()) : goDown(indexIt, c, Rev());
+}
+
+template <typename TIndexIt, typename TNeedleIt, typename TLambda>
+inline void
+__goDownSpaced(TIndexIt const & indexIt,
+               SpacedSeed const & seed,
+               size_t const step,
+               TNeedleIt const & needleIt,
+               TLambda & reportRunnable)
+{
+    using TAlph = typename Value<TNeedleIt>::Type;
+
+    if (step == seed.order.size())
+    {
+        reportRunnable(indexIt);
+        return;
+    }
+
+    size_t const pos = seed.order[step];
+    bool const fwd = (step < seed.nFwd);
+
+    if (seed.care[pos])
+    {
+        TIndexIt nextIndexIt(indexIt);
+        if (_goDownDir(nextIndexIt, *(needleIt + pos), fwd))
+            __goDownSpaced(nextIndexIt, seed, step + 1, needleIt, reportRunnable);
+    }
+    else
+    {
+        for (unsigned i = 0; i < ValueSize<TAlph>::VALUE; ++i)
+        {
+            TIndexIt nextIndexIt(indexIt);
+            if (_goDownDir(nextIndexIt, static_cast<TAlph>(i), fwd))
+                __goDownSpaced(nextIndexIt, seed, step + 1, needleIt, reportRunnable);
+        }
+    }
+}
+
+template <typename TGlobalHolder,
+          typename TScoreExtension>
+inline void
+_searchSingleIndexSpaced(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
+{
+    typedef typename Iterator<typename TGlobalHolder::TDbIndex, TopDown<> >::Type TIndexIt;
+
+    std::vector<SpacedSeed> seeds;
+    for (std::string const & pattern : lH.options.seedPatterns)
+        seeds.emplace_back(pattern, TGlobalHolder::indexIsBiFM);
+
+    TIndexIt root(lH.gH.dbIndex);
+    bool const useCache = lH.gH.seedCache.enabled();
+
+    for (size_t i = lH.indexBeginQry; i < lH.indexEndQry; ++i)
+    {
+        // exact duplicates are not searched, they get the results of the first query with the same sequence
+        if (!lH.gH.qryIsDup.empty() && lH.gH.qryIsDup[i / qNumFrames(TGlobalHolder::blastProgram)])
+            continue;
+
+        size_t const len = length(lH.gH.redQrySeqs[i]);
+
+        for (size_t s = 0; s < seeds.size(); ++s)
+        {
+            SpacedSeed const & seed = seeds[s];
+            size_t const span = seed.care.size();
+            if (len < span)
+                continue;
+
+            for (size_t seedBegin = 0; /* below */; seedBegin += lH.options.seedOffset)
+            {
+                // skip proteine 'X' or Dna 'N' and masked regions
+                while (_skipSeedStart(lH.gH, i, seedBegin) &&
+                       (seedBegin <= len - span))
+                    ++seedBegin;
+
+                // termination criterium
+                if (seedBegin > len - span)
+                    break;
+
+                auto reportRunnable = [&lH, &i, &seedBegin, span] (auto const & indexIt, bool const /*hasError*/)
+                {
+                #ifdef LAMBDA_MICRO_STATS
+                    appendValue(lH.stats.seedLengths, span);
+                #endif
+                    lH.stats.hitsAfterSeeding += countOccurrences(indexIt);
+                    _locateBatched(indexIt, [&] (auto const & occ)
+                    {
+                        onFindVariable(lH, occ, i, seedBegin, span);
+                    });
+                };
+
+                if (useCache)
+                {
+                    lH.seedCacheKey.assign({'S', static_cast<char>(s)});
+                    for (size_t k = seedBegin; k < seedBegin + span; ++k)
+                        lH.seedCacheKey.push_back(ordValue(lH.gH.redQrySeqs[i][k]));
+                    if (_seedCacheReplay(lH, reportRunnable))
+                        continue;
+                }
+
+                auto searchRunnable = [&lH, &reportRunnable, useCache] (auto const & indexIt)
+                {
+                    if (useCache)
+                        lH.seedCacheResults.emplace_back(indexIt, false);
+                    reportRunnable(indexIt, false);
+                };
+
+                __goDownSpaced(root, seed, 0, begin(lH.gH.redQrySeqs[i], Standard()) + seedBegin, searchRunnable);
+
+                if (useCache)
+                    lH.gH.seedCache.insert(lH.seedCacheKey, lH.seedCacheResults);
+            }
+        }
+    }
+}
+
+// SEARCH SCHEMES
+
+// see search_scheme.hpp for searchScheme()
+
+template <typename TIndexIt, typename TNeedleIt, typename TLambda>
+inline void
+__goDownScheme(TIndexIt const & indexIt,
+               SchemeSearch const & search,
+               size_t const step,
+               unsigned const errors,
+               TNeedleIt const & needleIt,
+               TLambda & reportRunnable)
+{
+    using TAlph = typename Value<TNeedleIt>::Type;
+
+    if (step == search.pos.size())
+    {
+        reportRunnable(indexIt, errors > 0);
+        return;
+    }
+
+    unsigned const c = ordValue(*(needleIt + search.pos[step]));
+
+    if (errors < search.maxErrors[step])
+    {
+        for (unsigned i = 0; i < ValueSize<TAlph>::VALUE; ++i)
+        {
+            unsigned const nextErrors = errors + (i != c);
+            TIndexIt nextIndexIt(indexIt);
+            if ((nextErrors >= search.minErrors[step]) &&
+                _goDownDir(nextIndexIt, static_cast<TAlph>(i), search.fwd[step]))
+                __goDownScheme(nextIndexIt, search, step + 1, nextErrors, needleIt, reportRunnable);
+        }
+    }
+    else if (errors >= search.minErrors[step])
+    {
+        TIndexIt nextIndexIt(indexIt);
+        if (_goDownDir(nextIndexIt, static_cast<TAlph>(c), search.fwd[step]))
+            __goDownScheme(nextIndexIt, search, step + 1, errors, needleIt, reportRunnable);
+    }
+}
+
+// seeds of fixed length with up to seed-delta errors, searched with a search scheme
+template <typename TGlobalHolder,
+          typename TScoreExtension>
+inline void
+_searchSingleIndexSchemes(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
+{
+    typedef typename Iterator<typename TGlobalHolder::TDbIndex, TopDown<> >::Type TIndexIt;
+
+    size_t const seedLength = lH.options.seedLength;
+    std::vector<SchemeSearch> const scheme = searchScheme(seedLength,
+                                                          lH.options.maxSeedDist,
+                                                          TGlobalHolder::indexIsBiFM,
+                                                          lH.options.seedHalfExact);
+
+    TIndexIt root(lH.gH.dbIndex);
+    bool const useCache = lH.gH.seedCache.enabled();
+
+    auto saBegin = [] (auto const & r) { return beginPosition(getOccurrences(r.first)); };
+
+    for (size_t i = lH.indexBeginQry; i < lH.indexEndQry; ++i)
+    {
+        // exact duplicates are not searched, they get the results of the first query with the same sequence
+        if (!lH.gH.qryIsDup.empty() && lH.gH.qryIsDup[i / qNumFrames(TGlobalHolder::blastProgram)])
+            continue;
+
+        size_t const len = length(lH.gH.redQrySeqs[i]);
+        if (len < seedLength)
+            continue;
+
+        for (size_t seedBegin = 0; /* below */; seedBegin += lH.options.seedOffset)
+        {
+            // skip proteine 'X' or Dna 'N' and masked regions
+            while (_skipSeedStart(lH.gH, i, seedBegin) &&
+                   (seedBegin <= len - seedLength))
+                ++seedBegin;
+
+            // termination criterium
+            if (seedBegin > len - seedLength)
+                break;
+
+            auto reportRunnable = [&lH, &i, &seedBegin, seedLength] (auto const & indexIt, bool const /*hasError*/)
+            {
+            #ifdef LAMBDA_MICRO_STATS
+                appendValue(lH.stats.seedLengths, seedLength);
+            #endif
+                lH.stats.hitsAfterSeeding += countOccurrences(indexIt);
+                _locateBatched(indexIt, [&] (auto const & occ)
+                {
+                    onFindVariable(lH, occ, i, seedBegin, seedLength);
+                });
+            };
+
+            if (useCache)
+            {
+                lH.seedCacheKey.assign(1, 'E');
+                for (size_t k = seedBegin; k < seedBegin + seedLength; ++k)
+                    lH.seedCacheKey.push_back(ordValue(lH.gH.redQrySeqs[i][k]));
+                if (_seedCacheReplay(lH, reportRunnable))
+                    continue;
+            }
+
+            lH.seedCacheResults.clear();
+            auto collectRunnable = [&lH] (auto const & indexIt, bool const hasError)
+            {
+                lH.seedCacheResults.emplace_back(indexIt, hasError);
+            };
+
+            for (SchemeSearch const & search : scheme)
+                __goDownScheme(root, search, 0, 0, begin(lH.gH.redQrySeqs[i], Standard()) + seedBegin, collectRunnable);
+
+            // the searches of a scheme may overlap, every suffix array range is reported once
+            std::sort(lH.seedCacheResults.begin(), lH.seedCacheResults.end(),
+                      [&saBegin] (auto const & a, auto const & b) { return saBegin(a) < saBegin(b); });
+            lH.seedCacheResults.erase(std::unique(lH.seedCacheResults.begin(), lH.seedCacheResults.end(),
+                                                  [&saBegin] (auto const & a, auto const & b)
+                                                  { return saBegin(a) == saBegin(b); }),
+                                      lH.seedCacheResults.end());
+
+            if (useCache)
+                lH.gH.seedCache.insert(lH.seedCacheKey, lH.seedCacheResults);
+
+            for (auto const & r : lH.seedCacheResults)
+                reportRunnable(r.first, r.second);
+        }
+    }
+}
+
+// spaced seeds, seeds with more than one error, or contiguous seeds where the continuation policy is a template
+// parameter, so that it can be inlined
+template <typename TGlobalHolder,
+          typename TScoreExtension>
+inline void
+_searchSingleIndex(LocalDataHolder<TGlobalHolder, TScoreExtension> & lH)
+{
+    size_t const minLength = lH.options.seedLength + /*hasError* */ lH.options.seedDeltaIncreasesLength;
+
+    if (!lH.options.seedPatterns.empty())
+        _searchSingleIndexSpaced(lH);
+    else if (lH.options.maxSeedDist > 1)
+        _searchSingleIndexSchemes(lH);
+    else if (lH.options.adaptiveSeeding)
+        _searchSingleIndex(lH, SeedContinAdaptive{minLength});
+    else
+        _searchSingleIndex(lH, SeedContinFixed{minLength});
+
+    preScoreBatch(lH);
+}
+
 #ifdef LAMBDA_LEGACY_PATHS
 template <typename TLocalHolder>
 inline void
@@ -1250,10 +2475,10 @@ sortMatches(TLocalHolder & lH)
 
     if ((lH.options.filterPutativeAbundant) &&
         (lH.matches.size() > lH.options.maxMatches))
-        // more expensive sort to get likely targets to front
-        myHyperSortSingleIndex(lH.matches, lH.options.doubleIndexing, lH.gH);
+        // more expensive sort to get likely targets to front (only for queries with more than maxMatches matches)
+        myHyperSortSingleIndex(lH.matches, lH.options.maxMatches, lH.gH);
     else
-        std::sort(lH.matches.begin(), lH.matches.end());
+        radixSortMatches(lH.matches);
 
     double finish = sysTime() - start;
 
@@ -1307,6 +2532,70 @@ _setFrames(TBlastMatch                          & bm,
     }
 }
 
+// --------------------------------------------------------------------------
+// Function _newBlastMatch()
+// --------------------------------------------------------------------------
+
+// like list.emplace_back(qId, sId), but takes the node from lH.blastMatchPool if there is one, so that the extension
+// does not allocate (and free) a list node per match. A recycled match is reset to the state of a new one in place:
+// its id strings, alignment rows and taxonomic ids are emptied but keep their memory.
+template <typename TLocalHolder,
+          typename TList,
+          typename TQId,
+          typename TSId>
+inline typename TLocalHolder::TBlastMatch &
+_newBlastMatch(TLocalHolder & lH, TList & list, TQId const & qId, TSId const & sId)
+{
+    using TBlastMatch = typename TLocalHolder::TBlastMatch;
+
+    if (lH.blastMatchPool.empty())
+    {
+        list.emplace_back(qId, sId);
+        return list.back();
+    }
+
+    list.splice(list.end(), lH.blastMatchPool, lH.blastMatchPool.begin());
+    TBlastMatch & bm = list.back();
+
+    static TBlastMatch const fresh{}; // the values of a new match
+    assign(bm.qId, qId);
+    assign(bm.sId, sId);
+    bm.qStart       = fresh.qStart;
+    bm.qEnd         = fresh.qEnd;
+    bm.sStart       = fresh.sStart;
+    bm.sEnd         = fresh.sEnd;
+    bm.qLength      = fresh.qLength;
+    bm.sLength      = fresh.sLength;
+    bm.qFrameShift  = fresh.qFrameShift;
+    bm.sFrameShift  = fresh.sFrameShift;
+    bm.eValue       = fresh.eValue;
+    bm.bitScore     = fresh.bitScore;
+    bm.alignStats   = fresh.alignStats;
+    bm._n_qId       = fresh._n_qId;
+    bm._n_sId       = fresh._n_sId;
+    clearGaps(bm.alignRow0);
+    clearGaps(bm.alignRow1);
+    resize(bm.sTaxIds, 0);
+    return bm;
+}
+
+// --------------------------------------------------------------------------
+// Function _recycleBlastMatches()
+// --------------------------------------------------------------------------
+
+// like list.erase(first, last), but the nodes are moved to lH.blastMatchPool for _newBlastMatch()
+template <typename TLocalHolder,
+          typename TList>
+inline typename TList::iterator
+_recycleBlastMatches(TLocalHolder & lH,
+                     TList & list,
+                     typename TList::iterator const first,
+                     typename TList::iterator const last)
+{
+    lH.blastMatchPool.splice(lH.blastMatchPool.end(), list, first, last);
+    return last;
+}
+
 // --------------------------------------------------------------------------
 // Function _writeMatches()
 // --------------------------------------------------------------------------
@@ -1373,7 +2662,10 @@ _writeRecord(TBlastRecord & record,
         {
             lH.stats.hitsAbundant += record.matches.size() -
                                         lH.options.maxMatches;
-            record.matches.resize(lH.options.maxMatches);
+            _recycleBlastMatches(lH,
+                                 record.matches,
+                                 std::next(record.matches.begin(), lH.options.maxMatches),
+                                 record.matches.end());
         }
         lH.stats.hitsFinal += record.matches.size();
 
@@ -1399,8 +2691,34 @@ _writeRecord(TBlastRecord & record,
             record.lcaId = lH.gH.taxNames[record.lcaTaxId];
         }
 
+        // duplicates before this query come first
+        myFlushDuplicates(lH, record.matches.front()._n_qId);
+
         myWriteRecord(lH, record);
+
+        // exact duplicates of this query were not searched, they are given the same results; the records are kept
+        // until the writer reaches the duplicate's position (see myFlushDuplicates())
+        if (!lH.gH.qryDupNext.empty())
+        {
+            for (uint64_t d = lH.gH.qryDupNext[record.matches.front()._n_qId];
+                 d != TLocalHolder::TGlobalHolder::noDuplicate;
+                 d = lH.gH.qryDupNext[d])
+            {
+                ++lH.stats.qrysWithHit;
+                lH.stats.hitsFinal += record.matches.size();
+                record.qId = lH.gH.qryIds[d];
+                for (auto & bm : record.matches)
+                {
+                    bm.qId    = record.qId;
+                    bm._n_qId = d;
+                }
+                myWriteRecord(lH, record, lH.gH.qryDupRecords[d]);
+            }
+        }
     }
+
+    // the matches are not needed anymore
+    _recycleBlastMatches(lH, record.matches, record.matches.begin(), record.matches.end());
 }
 
 // --------------------------------------------------------------------------
@@ -1752,19 +3070,9 @@ iterateMatchesExtend(TLocalHolder & lH)
     using TGlobalHolder = typename TLocalHolder::TGlobalHolder;
 //     using TMatch        = typename TGlobalHolder::TMatch;
 //     using TPos          = typename TMatch::TPos;
-    using TBlastPos     = uint32_t; //TODO why can't this be == TPos
-    using TBlastMatch   = BlastMatch<
-                           typename TLocalHolder::TAlignRow0,
-                           typename TLocalHolder::TAlignRow1,
-                           TBlastPos,
-                           typename Value<typename TGlobalHolder::TQryIds>::Type,// const &,
-                           typename Value<typename TGlobalHolder::TSubjIds>::Type// const &,
-                           >;
-    using TBlastRecord  = BlastRecord<TBlastMatch,
-                                      typename Value<typename TGlobalHolder::TQryIds>::Type,
-                                      std::vector<std::string>,
-                                      typename Value<typename TGlobalHolder::TTaxNames>::Type,
-                                      uint32_t>;
+    using TBlastPos     = typename TLocalHolder::TBlastPos;
+    using TBlastMatch   = typename TLocalHolder::TBlastMatch;
+    using TBlastRecord  = typename TLocalHolder::TBlastRecord;
 
 //     constexpr TPos TPosMax = std::numeric_limits<TPos>::max();
 //     constexpr uint8_t qFactor = qHasRevComp(TGlobalHolder::blastProgram) ? 3 : 1;
@@ -1888,7 +3196,10 @@ iterateMatchesExtend(TLocalHolder & lH)
                         }
                         if (record.matches.size() > (lH.options.maxMatches + 1))
                             // +1 so as not to trigger % == 0 in the next run
-                            record.matches.resize(lH.options.maxMatches + 1);
+                            _recycleBlastMatches(lH,
+                                                 record.matches,
+                                                 std::next(record.matches.begin(), lH.options.maxMatches + 1),
+                                                 record.matches.end());
 
                         lH.stats.hitsAbundant += before - record.matches.size();
 
@@ -1919,14 +3230,12 @@ iterateMatchesExtend(TLocalHolder & lH)
                 }
 //                 std::cout << "BAX\n" << std::flush;
                 // create blastmatch in list without copy or move
-                record.matches.emplace_back(lH.gH.subjIds[trueSubjId]);
-
-                auto & bm = back(record.matches);
+                auto & bm = _newBlastMatch(lH, record.matches, record.qId, lH.gH.subjIds[trueSubjId]);
 
                 bm.qStart    = it->qryStart;
-                bm.qEnd      = it->qryEnd; // it->qryStart + lH.options.seedLength;
+                bm.qEnd      = it->qryEnd(); // it->qryStart + lH.options.seedLength;
                 bm.sStart    = it->subjStart;
-                bm.sEnd      = it->subjEnd;//it->subjStart + lH.options.seedLength;
+                bm.sEnd      = it->subjEnd();//it->subjStart + lH.options.seedLength;
 
                 bm.sLength = sIsTranslated(TGlobalHolder::blastProgram)
                                 ? lH.gH.untransSubjSeqLengths[trueSubjId]
@@ -1967,8 +3276,8 @@ iterateMatchesExtend(TLocalHolder & lH)
                             if ((qDist == sDist) &&
                                 (qDist <= (long)lH.options.seedGravity))
                             {
-                                bm.qEnd = std::max(bm.qEnd, static_cast<TBlastPos>(it2->qryEnd));
-                                bm.sEnd = std::max(bm.sEnd, static_cast<TBlastPos>(it2->subjEnd));
+                                bm.qEnd = std::max(bm.qEnd, static_cast<TBlastPos>(it2->qryEnd()));
+                                bm.sEnd = std::max(bm.sEnd, static_cast<TBlastPos>(it2->subjEnd()));
                                 ++lH.stats.hitsMerged;
 
                                 setToSkip(*it2);
@@ -2006,19 +3315,19 @@ iterateMatchesExtend(TLocalHolder & lH)
                           << "subjId: " << it->subjId << "\t"
                           << "seed    qry: " << infix(lH.gH.redQrySeqs,
                                                       it->qryStart,
-                                                      it->qryEnd)
+                                                      it->qryEnd())
 //                                                       it->qryStart + lH.options.seedLength)
                           << "\n       subj: " << infix(lH.gH.redSubjSeqs,
                                                       it->subjStart,
-                                                      it->subjEnd)
+                                                      it->subjEnd())
 //                                                       it->subjStart + lH.options.seedLength)
                           << "\nunred  qry: " << infix(lH.gH.qrySeqs,
                                                       it->qryStart,
-                                                      it->qryEnd)
+                                                      it->qryEnd())
 //                                                       it->qryStart + lH.options.seedLength)
                           << "\n       subj: " << infix(lH.gH.subjSeqs,
                                                       it->subjStart,
-                                                      it->subjEnd)
+                                                      it->subjEnd())
 //                                                       it->subjStart + lH.options.seedLength)
                           << "\nmatch    qry: " << infix(lH.gH.qrySeqs,
                                                       bm.qStart,
@@ -2034,7 +3343,10 @@ iterateMatchesExtend(TLocalHolder & lH)
 
                 if (lret != 0)// discard match
                 {
-                    record.matches.pop_back();
+                    _recycleBlastMatches(lH,
+                                         record.matches,
+                                         std::prev(record.matches.end()),
+                                         record.matches.end());
                 } else if (lH.options.filterPutativeDuplicates)
                 {
                     // PUTATIVE DUBLICATES CHECK
@@ -2048,12 +3360,12 @@ iterateMatchesExtend(TLocalHolder & lH)
                         if ((it->qryId == it2->qryId) &&
                             (it->subjId == it2->subjId) &&
                             (intervalOverlap(it2->qryStart,
-                                             it2->qryEnd,
+                                             it2->qryEnd(),
 //                                              it2->qryStart + lH.options.seedLength,
                                              bm.qStart,
                                              bm.qEnd) > 0) &&
                             (intervalOverlap(it2->subjStart,
-                                             it2->subjEnd,
+                                             it2->subjEnd(),
 //                                              it2->subjStart + lH.options.seedLength,
                                              bm.sStart,
                                              bm.sEnd) > 0))
@@ -2109,7 +3421,7 @@ _setupAlignInfix(TBlastMatch & bm,
                  typename TLocalHolder::TMatch const & m,
                  TLocalHolder & lH)
 {
-    int64_t startMod = (int64_t)m.subjStart - (int64_t)m.qryStart;
+    int64_t startMod = m.diagonal();
 
     bm.qEnd = length(lH.gH.qrySeqs[m.qryId]);
     decltype(bm.qEnd) band = _bandSize(bm.qEnd , lH);
@@ -2334,19 +3646,9 @@ iterateMatchesFullSimd(TLocalHolder & lH)
     using TGlobalHolder = typename TLocalHolder::TGlobalHolder;
 //     using TMatch        = typename TGlobalHolder::TMatch;
 //     using TPos          = typename TMatch::TPos;
-    using TBlastPos     = uint32_t; //TODO why can't this be == TPos
-    using TBlastMatch   = BlastMatch<
-                           typename TLocalHolder::TAlignRow0,
-                           typename TLocalHolder::TAlignRow1,
-                           TBlastPos,
-                           typename Value<typename TGlobalHolder::TQryIds>::Type,// const &,
-                           typename Value<typename TGlobalHolder::TSubjIds>::Type// const &,
-                           >;
-    using TBlastRecord  = BlastRecord<TBlastMatch,
-                                      typename Value<typename TGlobalHolder::TQryIds>::Type,
-                                      std::vector<std::string>,
-                                      typename Value<typename TGlobalHolder::TTaxNames>::Type,
-                                      uint32_t>;
+    using TBlastPos     = typename TLocalHolder::TBlastPos;
+    using TBlastMatch   = typename TLocalHolder::TBlastMatch;
+    using TBlastRecord  = typename TLocalHolder::TBlastRecord;
     // statistics
 #ifdef LAMBDA_MICRO_STATS
     ++lH.stats.numQueryWithExt;
@@ -2366,10 +3668,10 @@ iterateMatchesFullSimd(TLocalHolder & lH)
     for (auto it = lH.matches.begin(), itEnd = lH.matches.end(); it != itEnd; ++it)
     {
         // create blastmatch in list without copy or move
-        blastMatches.emplace_back(lH.gH.qryIds [it->qryId / qNumFrames(TGlobalHolder::blastProgram)],
-                                    lH.gH.subjIds[it->subjId / sNumFrames(TGlobalHolder::blastProgram)]);
-
-        auto & bm = back(blastMatches);
+        auto & bm = _newBlastMatch(lH,
+                                   blastMatches,
+                                   lH.gH.qryIds [it->qryId / qNumFrames(TGlobalHolder::blastProgram)],
+                                   lH.gH.subjIds[it->subjId / sNumFrames(TGlobalHolder::blastProgram)]);
 
         bm._n_qId = it->qryId / qNumFrames(TGlobalHolder::blastProgram);
         bm._n_sId = it->subjId / sNumFrames(TGlobalHolder::blastProgram);
@@ -2440,7 +3742,7 @@ iterateMatchesFullSimd(TLocalHolder & lH)
         if (bm.eValue > lH.options.eCutOff)
         {
             ++lH.stats.hitsFailedExtendEValueTest;
-            it = blastMatches.erase(it);
+            it = _recycleBlastMatches(lH, blastMatches, it, std::next(it));
             continue;
         }
 
@@ -2480,7 +3782,7 @@ iterateMatchesFullSimd(TLocalHolder & lH)
         if (bm.alignStats.alignmentIdentity < lH.options.idCutOff)
         {
             ++lH.stats.hitsFailedExtendPercentIdentTest;
-            it = blastMatches.erase(it);
+            it = _recycleBlastMatches(lH, blastMatches, it, std::next(it));
             continue;
         }
 
@@ -2538,19 +3840,9 @@ iterateMatchesFullSerial(TLocalHolder & lH)
     using TGlobalHolder = typename TLocalHolder::TGlobalHolder;
 //     using TMatch        = typename TGlobalHolder::TMatch;
 //     using TPos          = typename TMatch::TPos;
-    using TBlastPos     = uint32_t; //TODO why can't this be == TPos
-    using TBlastMatch   = BlastMatch<
-                           typename TLocalHolder::TAlignRow0,
-                           typename TLocalHolder::TAlignRow1,
-                           TBlastPos,
-                           typename Value<typename TGlobalHolder::TQryIds>::Type,// const &,
-                           typename Value<typename TGlobalHolder::TSubjIds>::Type// const &,
-                           >;
-    using TBlastRecord  = BlastRecord<TBlastMatch,
-                                      typename Value<typename TGlobalHolder::TQryIds>::Type,
-                                      std::vector<std::string>,
-                                      typename Value<typename TGlobalHolder::TTaxNames>::Type,
-                                      uint32_t>;
+    using TBlastPos     = typename TLocalHolder::TBlastPos;
+    using TBlastMatch   = typename TLocalHolder::TBlastMatch;
+    using TBlastRecord  = typename TLocalHolder::TBlastRecord;
 
     auto const trueQryId = lH.matches[0].qryId / qNumFrames(TGlobalHolder::blastProgram);
 
@@ -2569,10 +3861,10 @@ iterateMatchesFullSerial(TLocalHolder & lH)
     for (auto it = lH.matches.begin(), itEnd = lH.matches.end(); it != itEnd; ++it)
     {
         // create blastmatch in list without copy or move
-        record.matches.emplace_back(lH.gH.qryIds [it->qryId / qNumFrames(TGlobalHolder::blastProgram)],
-                                    lH.gH.subjIds[it->subjId / sNumFrames(TGlobalHolder::blastProgram)]);
-
-        auto & bm = back(record.matches);
+        auto & bm = _newBlastMatch(lH,
+                                   record.matches,
+                                   lH.gH.qryIds [it->qryId / qNumFrames(TGlobalHolder::blastProgram)],
+                                   lH.gH.subjIds[it->subjId / sNumFrames(TGlobalHolder::blastProgram)]);
         auto &  m = *it;
 
         bm._n_qId = it->qryId / qNumFrames(TGlobalHolder::blastProgram);
@@ -2602,7 +3894,10 @@ iterateMatchesFullSerial(TLocalHolder & lH)
         if (bm.eValue > lH.options.eCutOff)
         {
             ++lH.stats.hitsFailedExtendEValueTest;
-            record.matches.pop_back();
+            _recycleBlastMatches(lH,
+                                 record.matches,
+                                 std::prev(record.matches.end()),
+                                 record.matches.end());
             continue;
         }
 
@@ -2620,7 +3915,10 @@ iterateMatchesFullSerial(TLocalHolder & lH)
         if (bm.alignStats.alignmentIdentity < lH.options.idCutOff)
         {
             ++lH.stats.hitsFailedExtendPercentIdentTest;
-            record.matches.pop_back();
+            _recycleBlastMatches(lH,
+                                 record.matches,
+                                 std::prev(record.matches.end()),
+                                 record.matches.end());
             continue;
         }
 
@@ -0,0 +1,88 @@
+// ==========================================================================
+//                                  lambda
+// ==========================================================================
+// Copyright (c) 2013-2019, Hannes Hauswedell <h2 @ fsfe.org>
+// Copyright (c) 2016-2019, Knut Reinert and Freie Universität Berlin
+// All rights reserved.
+//
+// This file is part of Lambda.
+//
+// Lambda is Free Software: you can redistribute it and/or modify it
+// under the terms found in the LICENSE[.md|.rst] file distributed
+// together with this file.
+//
+// Lambda is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+// ==========================================================================
+// search_blocks.hpp: partitioning of the queries into blocks and their order
+// ==========================================================================
+
+#ifndef LAMBDA_SEARCH_BLOCKS_H_
+#define LAMBDA_SEARCH_BLOCKS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// Borders of blocks of consecutive queries, block i is [limits[i], limits[i+1]). Queries are merged until a block
+// reaches targetCost, so a target of 0 gives one block per query.
+inline std::vector<uint64_t>
+mergeQueryBlocks(std::vector<uint64_t> const & costs, uint64_t const targetCost)
+{
+    std::vector<uint64_t> limits{0};
+    uint64_t acc = 0;
+    for (uint64_t q = 0; q < costs.size(); ++q)
+    {
+        acc += costs[q];
+        if ((acc >= targetCost) || (q + 1 == costs.size()))
+        {
+            limits.push_back(q + 1);
+            acc = 0;
+        }
+    }
+    return limits;
+}
+
+// Borders of exactly nBlocks blocks of consecutive queries, the k-th border is where k/nBlocks of the total cost is
+// reached (blocks may be empty).
+inline std::vector<uint64_t>
+splitQueryBlocks(std::vector<uint64_t> const & costs, uint64_t const nBlocks)
+{
+    uint64_t const total = std::accumulate(costs.begin(), costs.end(), uint64_t{0});
+    std::vector<uint64_t> limits{0};
+    uint64_t q = 0;
+    uint64_t acc = 0;
+    for (uint64_t k = 1; k < nBlocks; ++k)
+    {
+        while ((q < costs.size()) && (acc * nBlocks < total * k))
+            acc += costs[q++];
+        limits.push_back(q);
+    }
+    limits.push_back(costs.size());
+    return limits;
+}
+
+// Order in which the blocks are searched: the most expensive blocks first, so that a long query does not keep the
+// other threads waiting at the end. The writer writes the blocks in their original order and the threads may only
+// run a limited number of blocks ahead of it (see myWaitForOutputWindow()), so the blocks are only reordered within
+// consecutive groups of groupSize blocks; a global order would let an expensive block at the end of the file take a
+// thread while the blocks before it are stuck behind the window.
+inline std::vector<uint64_t>
+orderQueryBlocks(std::vector<uint64_t> const & blockCosts, uint64_t const groupSize)
+{
+    uint64_t const nBlocks = blockCosts.size();
+    uint64_t const g       = std::max<uint64_t>(1, groupSize);
+    std::vector<uint64_t> order(nBlocks);
+    std::iota(order.begin(), order.end(), 0);
+
+    for (uint64_t b = 0; b < nBlocks; b += g)
+        std::stable_sort(order.begin() + b,
+                         order.begin() + std::min(b + g, nBlocks),
+                         [&blockCosts] (uint64_t const l, uint64_t const r) { return blockCosts[l] > blockCosts[r]; });
+    return order;
+}
+
+#endif // LAMBDA_SEARCH_BLOCKS_H_
@@ -22,7 +22,17 @@
 #ifndef LAMBDA_SEARCH_DATASTRUCTURES_H_
 #define LAMBDA_SEARCH_DATASTRUCTURES_H_
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 #include <seqan/align_extend.h>
+#include <seqan/parallel.h>
 
 // ============================================================================
 // Tags, Classes, Enums
@@ -32,6 +42,8 @@
 // struct Match
 // ----------------------------------------------------------------------------
 
+// A hit always lies on a single diagonal, so only the start positions and the length are stored; the ends (and the
+// diagonal) are derived from them. This saves one position per hit, i.e. 4 bytes with 32bit positions.
 template<typename TAlph>
 struct Match
 {
@@ -42,20 +54,32 @@ struct Match
     TQId qryId;
     TSId subjId;
     TPos qryStart;
-    TPos qryEnd;
-
     TPos subjStart;
-    TPos subjEnd;
+    TPos length;
 
+    inline TPos qryEnd() const
+    {
+        return qryStart + length;
+    }
+    inline TPos subjEnd() const
+    {
+        return subjStart + length;
+    }
+    inline int64_t diagonal() const
+    {
+        return static_cast<int64_t>(subjStart) - static_cast<int64_t>(qryStart);
+    }
+
+    // the order is the same as for (qryId, subjId, qryStart, subjStart, qryEnd, subjEnd)
     inline bool operator== (Match const & m2) const
     {
-         return std::tie(qryId, subjId, qryStart, subjStart, qryEnd, subjEnd)
-             == std::tie(m2.qryId, m2.subjId, m2.qryStart, m2.subjStart, m2.qryEnd, m2.subjEnd);
+         return std::tie(qryId, subjId, qryStart, subjStart, length)
+             == std::tie(m2.qryId, m2.subjId, m2.qryStart, m2.subjStart, m2.length);
     }
     inline bool operator< (Match const & m2) const
     {
-         return std::tie(qryId, subjId, qryStart, subjStart, qryEnd, subjEnd)
-              < std::tie(m2.qryId, m2.subjId, m2.qryStart, m2.subjStart, m2.qryEnd, m2.subjEnd);
+         return std::tie(qryId, subjId, qryStart, subjStart, length)
+              < std::tie(m2.qryId, m2.subjId, m2.qryStart, m2.subjStart, m2.length);
     }
 };
 
@@ -83,9 +107,9 @@ inline void
 _printMatch(Match<TAlph> const & m)
 {
     std::cout << "MATCH  Query " << m.qryId
-              << "(" << m.qryStart << ", " << m.qryEnd
+              << "(" << m.qryStart << ", " << m.qryEnd()
               << ")   on Subject "<< m.subjId
-              << "(" << m.subjStart << ", " << m.subjEnd
+              << "(" << m.subjStart << ", " << m.subjEnd()
               << ")" <<  std::endl << std::flush;
 }
 
@@ -100,12 +124,15 @@ struct StatsHolder
     uint64_t hitsMerged;
     uint64_t hitsTooShort;
     uint64_t hitsMasked;
+    uint64_t seedCacheHits;
+    uint64_t seedCacheMisses;
 #ifdef LAMBDA_MICRO_STATS
     std::vector<uint16_t> seedLengths;
 #endif
 
 // pre-extension
     uint64_t hitsFailedPreExtendTest;
+    uint64_t hitsFailedTwoHitTest;
     uint64_t hitsPutativeDuplicate;
     uint64_t hitsPutativeAbundant;
 
@@ -144,8 +171,11 @@ struct StatsHolder
         hitsMerged = 0;
         hitsTooShort = 0;
         hitsMasked = 0;
+        seedCacheHits = 0;
+        seedCacheMisses = 0;
 
         hitsFailedPreExtendTest = 0;
+        hitsFailedTwoHitTest = 0;
         hitsPutativeDuplicate = 0;
         hitsPutativeAbundant = 0;
 
@@ -177,8 +207,11 @@ struct StatsHolder
         hitsMerged += rhs.hitsMerged;
         hitsTooShort += rhs.hitsTooShort;
         hitsMasked += rhs.hitsMasked;
+        seedCacheHits += rhs.seedCacheHits;
+        seedCacheMisses += rhs.seedCacheMisses;
 
         hitsFailedPreExtendTest += rhs.hitsFailedPreExtendTest;
+        hitsFailedTwoHitTest += rhs.hitsFailedTwoHitTest;
         hitsPutativeDuplicate += rhs.hitsPutativeDuplicate;
         hitsPutativeAbundant += rhs.hitsPutativeAbundant;
 
@@ -253,6 +286,10 @@ void printStats(StatsHolder const & stats, LambdaOptions const & options)
             std::cout << "\n - failed pre-extend test   " << R
                       << stats.hitsFailedPreExtendTest  << RR
                       << (rem -= stats.hitsFailedPreExtendTest);
+        if (options.twoHitWindow)
+            std::cout << "\n - failed two-hit test      " << R
+                      << stats.hitsFailedTwoHitTest << RR
+                      << (rem -= stats.hitsFailedTwoHitTest);
         std::cout << "\n - failed %-identity test   " << R
                   << stats.hitsFailedExtendPercentIdentTest << RR
                   << (rem -= stats.hitsFailedExtendPercentIdentTest);
@@ -270,6 +307,10 @@ void printStats(StatsHolder const & stats, LambdaOptions const & options)
         if (rem != stats.hitsFinal)
             std::cout << "WARNING: hits don't add up\n";
 
+        if (stats.seedCacheHits + stats.seedCacheMisses > 0)
+            std::cout << "Seed cache hits / misses:  " << stats.seedCacheHits << " / " << stats.seedCacheMisses
+                      << "\n\n";
+
     #ifdef LAMBDA_MICRO_STATS
         std::cout << "Detailed Non-Wall-Clock times:\n"
                   << " genSeeds:    " << stats.timeGenSeeds << "\n"
@@ -318,6 +359,154 @@ void printStats(StatsHolder const & stats, LambdaOptions const & options)
 
 }
 
+// ----------------------------------------------------------------------------
+// struct OutputChunk  -- formatted records of (a part of) one block of queries
+// ----------------------------------------------------------------------------
+
+struct OutputChunk
+{
+    uint64_t    block   = 0;
+    bool        last    = false; // no more records will follow for this block
+    CharString  buffer;
+    // if set, the chunk stands for the records of this exact duplicate query instead (see myFlushDuplicates())
+    static constexpr uint64_t noDuplicate = std::numeric_limits<uint64_t>::max();
+    uint64_t    duplicate = noDuplicate;
+};
+
+// ----------------------------------------------------------------------------
+// class SeedCache  -- results of seed searches, shared by all threads
+// ----------------------------------------------------------------------------
+
+// Maps the characters that a seed search reads (plus a tag for the kind of search) to the iterators that it
+// reported. The entries are distributed over shards that have their own lock; a full shard evicts an arbitrary entry.
+template <typename TIndexIt>
+class SeedCache
+{
+public:
+    using TResults = std::vector<std::pair<TIndexIt, bool>>;
+
+    void init(uint64_t const maxEntries)
+    {
+        maxPerShard = (maxEntries + nShards - 1) / nShards;
+        for (Shard & shard : shards)
+            shard.map.clear();
+    }
+
+    bool enabled() const
+    {
+        return maxPerShard > 0;
+    }
+
+    bool find(std::string const & key, TResults & results)
+    {
+        Shard & shard = shards[std::hash<std::string>{}(key) % nShards];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end())
+            return false;
+        results = it->second;
+        return true;
+    }
+
+    void insert(std::string const & key, TResults const & results)
+    {
+        Shard & shard = shards[std::hash<std::string>{}(key) % nShards];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if ((shard.map.size() >= maxPerShard) && (shard.map.count(key) == 0))
+            shard.map.erase(shard.map.begin());
+        shard.map[key] = results;
+    }
+
+private:
+    static constexpr size_t nShards = 64;
+
+    struct Shard
+    {
+        std::mutex                                  mutex;
+        std::unordered_map<std::string, TResults>   map;
+    };
+
+    std::array<Shard, nShards>  shards;
+    uint64_t                    maxPerShard = 0;
+};
+
+// ----------------------------------------------------------------------------
+// class TwoHitTable  -- last hit per query, subject and diagonal (see twoHitPasses())
+// ----------------------------------------------------------------------------
+
+// Open addressing with linear probing; the slots store the whole hit, so the full key is compared and colliding
+// diagonals never replace each other. Every slot remembers the generation it was written in, so that clear() does not
+// touch the slots and the table keeps its capacity from one block of queries to the next.
+template <typename TMatch>
+class TwoHitTable
+{
+public:
+    // return the last hit on the diagonal of m; if there is none, m becomes that hit and nullptr is returned
+    TMatch * findOrInsert(TMatch const & m)
+    {
+        if ((used + 1) * 2 > slots.size())
+            grow();
+
+        uint64_t const mask = slots.size() - 1;
+        for (uint64_t i = hash(m) & mask; /* below */; i = (i + 1) & mask)
+        {
+            Slot & slot = slots[i];
+            if (slot.generation != generation)
+            {
+                slot.generation = generation;
+                slot.match = m;
+                ++used;
+                return nullptr;
+            }
+
+            if ((slot.match.qryId == m.qryId) &&
+                (slot.match.subjId == m.subjId) &&
+                (slot.match.diagonal() == m.diagonal()))
+                return &slot.match;
+        }
+    }
+
+    void clear()
+    {
+        used = 0;
+        if (++generation == 0) // wrapped around, so old slots could look current
+        {
+            for (Slot & slot : slots)
+                slot.generation = 0;
+            generation = 1;
+        }
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t    generation = 0;
+        TMatch      match;
+    };
+
+    std::vector<Slot>   slots;
+    uint64_t            used = 0;
+    uint32_t            generation = 1;
+
+    static uint64_t hash(TMatch const & m)
+    {
+        uint64_t h = static_cast<uint64_t>(m.qryId) * 0x9E3779B97F4A7C15ull;
+        h = (h ^ static_cast<uint64_t>(m.subjId)) * 0xC2B2AE3D27D4EB4Full;
+        h = (h ^ static_cast<uint64_t>(m.diagonal())) * 0x165667B19E3779F9ull;
+        return h ^ (h >> 32);
+    }
+
+    void grow()
+    {
+        std::vector<Slot> old(std::max<size_t>(1024, 2 * slots.size()));
+        std::swap(old, slots);
+        used = 0;
+        for (Slot const & slot : old)
+            if (slot.generation == generation)
+                findOrInsert(slot.match);
+    }
+};
+
 // ----------------------------------------------------------------------------
 // struct GlobalDataHolder  -- one object per program
 // ----------------------------------------------------------------------------
@@ -350,17 +539,15 @@ public:
     using TMatch         = Match<TRedAlph>;
 
     static constexpr BlastProgram blastProgram  = p;
-    static constexpr bool indexIsBiFM           = std::is_same<TIndexSpec_, BidirectionalIndex<TFMIndexInBi<>>>::value;
-    static constexpr bool indexIsFM             = std::is_same<TIndexSpec_, TFMIndex<>>::value || indexIsBiFM;
+    static constexpr bool indexIsBiFM           = std::is_same<TIndexSpec_,
+        BidirectionalIndex<TFMIndexInBi<void, typename LambdaIndexStorage<TIndexSpec_>::Type>>>::value;
+    static constexpr bool indexIsFM             = std::is_same<TIndexSpec_,
+        TFMIndex<void, typename LambdaIndexStorage<TIndexSpec_>::Type>>::value || indexIsBiFM;
     static constexpr bool alphReduction         = !std::is_same<TransAlph<p>, TRedAlph>::value;
 
     /* Sequence storage types */
     using TStringTag    = Alloc<>;
-#if defined(LAMBDA_MMAPPED_DB)
-    using TDirectStringTag = MMap<>;
-#else
-    using TDirectStringTag = TStringTag;
-#endif
+    using TDirectStringTag = typename LambdaIndexStorage<TIndexSpec_>::Type; // MMap<> iff searching memory-mapped
     using TQryTag  = TStringTag;
     using TSubjTag = TDirectStringTag; // even if subjects were translated they are now loaded from disk
 
@@ -400,6 +587,7 @@ public:
     /* indeces and their type */
     using TIndexSpec    = TIndexSpec_;
     using TDbIndex      = Index<typename std::remove_reference<TRedSubjSeqs>::type, TIndexSpec>;
+    using TIndexIt      = typename Iterator<TDbIndex, TopDown<> >::Type;
 
     /* output file */
     using TScoreScheme  = std::conditional_t<std::is_same<TRedAlph, Dna5>::value,
@@ -407,12 +595,16 @@ public:
                                              Score<int, ScoreMatrix<AminoAcid, ScoreSpecSelectable>>>;
 //     using TScoreScheme  = TScoreScheme_;
     using TIOContext    = BlastIOContext<TScoreScheme, p, h>;
+    using TOutFormat    = TFileFormat;
     using TFile         = FormattedFile<TFileFormat, Output, TIOContext>;
-    using TBamFile      = FormattedFile<Bam, Output, BlastTabular>;
+    using TBamFile      = FormattedFile<Bam, Output, LambdaBamSpec<TSubjTag>>;
+    using TBamContext   = typename std::remove_reference<decltype(context(std::declval<TBamFile &>()))>::type;
+    using TOutBuffer    = CharString;
 
     /* misc types */
     using TPositions    = typename StringSetLimits<TTransQrySeqs>::Type;
-    using TMasking      = StringSet<String<unsigned>, Owner<ConcatDirect<>>>;
+    using TMasking      = StringSet<String<bool>, Owner<ConcatDirect<>>>; // same limits as qrySeqs
+    using TSubjMasking  = StringSet<String<uint64_t, TSubjTag>, Owner<ConcatDirect<>>>; // intervals [b, e)
     using TTaxIDs       = StringSet<String<uint32_t>, Owner<ConcatDirect<>>>;
     using TTaxParents   = String<uint32_t>;
     using TTaxHeights   = String<uint8_t>;
@@ -432,8 +624,42 @@ public:
     TQryIds             qryIds;
     TSubjIds            subjIds;
 
+    TSubjMasking        subjMasked;             // empty if the index has no masking, see dumpSubjMasking()
+
     TFile               outfile;
     TBamFile            outfileBam;
+    std::vector<TIOContext>  outContexts;       // one copy of the file contexts per thread, see myWriteHeader()
+    std::vector<TBamContext> outContextsBam;
+
+    // formatted records on their way from the search threads to the writer thread (see myPushChunk())
+    std::deque<OutputChunk> outQueue;
+    std::mutex          outMutex;               // guards outQueue, outQueueClosed and outNextBlock
+    std::condition_variable outQueueChanged;    // a chunk was added or the queue was closed
+    std::condition_variable outWindowChanged;   // outNextBlock advanced (see myWaitForOutputWindow())
+    std::atomic<bool>   outQueueClosed{false};
+    std::atomic<uint64_t> outNextBlock{0};  // blocks before this one have been written completely
+
+    // partitioning of qrySeqs into blocks, see computeQueryBlocks()
+    std::vector<uint64_t> blockLimits;      // block i is [blockLimits[i], blockLimits[i+1])
+    std::vector<uint64_t> blockOrder;       // order in which the blocks are processed
+
+    // low-complexity regions of qrySeqs (empty if not masking), see maskLowComplexityQueries()
+    TMasking            qryMasked;
+
+    // queries with identical sequences are searched once (empty if not collapsing), see collapseDuplicateQueries()
+    std::vector<uint64_t> qryDupNext;       // the next query with the same sequence, or noDuplicate
+    std::vector<bool>   qryIsDup;           // whether an earlier query has the same sequence
+    std::vector<TOutBuffer> qryDupRecords;  // records of the duplicates, formatted with those of the first query
+    static constexpr uint64_t noDuplicate = std::numeric_limits<uint64_t>::max();
+
+    // index iterators for all k-mers, so that seeds don't start at the root, see initKmerTable()
+    std::vector<TIndexIt> kmerItsFwd;
+    std::vector<TIndexIt> kmerItsRev;       // used iff indexIsBiFM
+    unsigned            kmerLenFwd = 0;
+    unsigned            kmerLenRev = 0;
+
+    // results of seed searches that do not depend on the query, see _searchSingleIndex()
+    SeedCache<TIndexIt> seedCache;
 
     TPositions          untransQrySeqLengths;   // used iff qIsTranslated(p)
     TPositions          untransSubjSeqLengths;  // used iff sIsTranslated(p)
@@ -480,6 +706,65 @@ public:
  *   indexText(dbIndex) is lightweight reduced StringSet and assigned redSubjSeqs in loadDbIndexFromDisk
  */
 
+// ----------------------------------------------------------------------------
+// struct QueryChunk  -- staging area for the next block of queries (streaming)
+// ----------------------------------------------------------------------------
+
+template <typename TGlobalHolder>
+struct QueryChunk
+{
+    typename TGlobalHolder::TQryIds         qryIds;
+    typename TGlobalHolder::TTransQrySeqs   qrySeqs;
+    typename TGlobalHolder::TUntransQrySeqs untranslatedQrySeqs;
+    typename TGlobalHolder::TPositions      untransQrySeqLengths;
+
+    unsigned long                           maxLen = 0ul;
+
+    // exact duplicates, see collapseDuplicateQueries()
+    std::vector<uint64_t>                   qryDupNext;
+    std::vector<bool>                       qryIsDup;
+    uint64_t                                nDuplicates = 0;
+
+    // low-complexity regions, see maskLowComplexityQueries()
+    typename TGlobalHolder::TMasking        qryMasked;
+    uint64_t                                nMasked = 0;
+
+    void clear()
+    {
+        seqan::clear(qryIds);
+        seqan::clear(qrySeqs);
+        seqan::clear(untranslatedQrySeqs);
+        seqan::clear(untransQrySeqLengths);
+        maxLen = 0ul;
+        qryDupNext.clear();
+        qryIsDup.clear();
+        nDuplicates = 0;
+        seqan::clear(qryMasked);
+        nMasked = 0;
+    }
+};
+
+// the query members of the global holder are swapped, not re-assigned, so that redQrySeqs (which
+// holds a reference to qrySeqs' concat string) remains valid
+template <typename TGlobalHolder>
+inline void
+swapQueryChunk(TGlobalHolder & globalHolder, QueryChunk<TGlobalHolder> & chunk)
+{
+    swap(globalHolder.qryIds,               chunk.qryIds);
+    swap(globalHolder.qrySeqs,              chunk.qrySeqs);
+    swap(globalHolder.untranslatedQrySeqs,  chunk.untranslatedQrySeqs);
+    swap(globalHolder.untransQrySeqLengths, chunk.untransQrySeqLengths);
+    std::swap(globalHolder.qryDupNext,      chunk.qryDupNext);
+    std::swap(globalHolder.qryIsDup,        chunk.qryIsDup);
+    swap(globalHolder.qryMasked,            chunk.qryMasked);
+
+    globalHolder.qryDupRecords.clear();
+    globalHolder.qryDupRecords.resize(globalHolder.qryIsDup.size());
+
+    if (TGlobalHolder::alphReduction)
+        globalHolder.redQrySeqs.limits = globalHolder.qrySeqs.limits;
+}
+
 // ----------------------------------------------------------------------------
 // struct LocalDataHolder  -- one object per thread
 // ----------------------------------------------------------------------------
@@ -509,6 +794,7 @@ public:
     // regarding range of queries
     uint64_t            indexBeginQry;
     uint64_t            indexEndQry;
+    uint64_t            nextDupQry;     // first (true) query whose duplicate records were not yet handed on
 
     // regarding seedingp
     TSeeds              seeds;
@@ -517,6 +803,22 @@ public:
     std::vector<TMatch>   matches;
     std::vector<typename TMatch::TQId> seedRefs;  // mapping seed -> query
     std::vector<typename TMatch::TPos> seedRanks; // mapping seed -> relative rank
+    std::string         seedCacheKey;
+    typename SeedCache<typename TGlobalHolder::TIndexIt>::TResults seedCacheResults;
+    TwoHitTable<TMatch> twoHitLast;
+
+    // hits waiting for pre-scoring and its buffers (see preScoreBatch())
+    std::vector<TMatch>     preScoreCands;
+    std::vector<int8_t>     preScoreTable;
+    std::vector<uint8_t>    preScorePassed;
+    // one entry per candidate that is still being scored ("lane")
+    std::vector<uint64_t>   preScoreQry;    // position in concat(qrySeqs)
+    std::vector<uint64_t>   preScoreSubj;   // position in concat(subjSeqs)
+    std::vector<uint64_t>   preScoreLen;
+    std::vector<int32_t>    preScoreThresh;
+    std::vector<int32_t>    preScoreCur;
+    std::vector<int32_t>    preScoreMax;
+    std::vector<uint32_t>   preScoreLane;   // index into preScoreCands
 
     // regarding extension
     using TAlignRow0 = Gaps<typename Infix<typename Value<typename TGlobalHolder::TTransQrySeqs>::Type>::Type,
@@ -546,6 +848,20 @@ public:
 
     using TAliExtContext = AliExtContext_<TAlignRow0, TAlignRow1, TDPContextNoSIMD>;
 
+    using TBlastPos     = uint32_t; //TODO why can't this be == TPos
+    using TBlastMatch   = BlastMatch<
+                           TAlignRow0,
+                           TAlignRow1,
+                           TBlastPos,
+                           typename Value<typename TGlobalHolder::TQryIds>::Type,// const &,
+                           typename Value<typename TGlobalHolder::TSubjIds>::Type// const &,
+                           >;
+    using TBlastRecord  = BlastRecord<TBlastMatch,
+                                      typename Value<typename TGlobalHolder::TQryIds>::Type,
+                                      std::vector<std::string>,
+                                      typename Value<typename TGlobalHolder::TTaxNames>::Type,
+                                      uint32_t>;
+
     TAliExtContext      alignContext;
 // #if defined(SEQAN_SIMD_ENABLED)
 //     TDPContextSIMD      alignSIMDContext;
@@ -554,64 +870,62 @@ public:
     // map from sequence length to band size
     std::unordered_map<uint64_t, int> bandTable;
 
+    // list nodes of dropped and written matches, reused for new ones (see _newBlastMatch())
+    decltype(TBlastRecord::matches) blastMatchPool;
+
     // regarding the gathering of stats
     StatsHolder         stats;
 
     // progress string
     std::stringstream   statusStr;
 
-    // constructor
+    // records are formatted here (with this thread's copies of the file contexts) and then handed to the writer thread
+    typename TGlobalHolder::TOutBuffer    outBuffer;
+    typename TGlobalHolder::TIOContext  & outContext;
+    typename TGlobalHolder::TBamContext & outContextBam;
+
+    // constructor, must be called by the thread that uses the object
     LocalDataHolder(LambdaOptions     const & _options,
                     TGlobalHolder     /*const*/ & _globalHolder) :
-        options(_options), gH(_globalHolder), stats()
+        options(_options), gH(_globalHolder), stats(),
+        outContext(_globalHolder.outContexts[_threadId()]),
+        outContextBam(_globalHolder.outContextsBam[_threadId()])
     {
-        if (options.doubleIndexing)
-        {
-            nBlocks = options.queryPart;
-        } else if (options.extensionMode == LambdaOptions::ExtensionMode::FULL_SIMD)
-        {
-            // division with rounding up
-            nBlocks = (length(gH.redQrySeqs) + qNumFrames(blastProgram) * 10 - 1) / (qNumFrames(blastProgram) * 10);
-        } else
-        {
-            nBlocks = length(gH.redQrySeqs) / qNumFrames(blastProgram);
-        }
+        nBlocks = gH.blockOrder.size();
     }
 
     // copy constructor SHALLOW COPY ONLY, REQUIRED FOR firsprivate()
     LocalDataHolder(LocalDataHolder const & rhs) :
-        options(rhs.options), gH(rhs.gH), stats()
+        options(rhs.options), gH(rhs.gH), stats(),
+        outContext(rhs.gH.outContexts[_threadId()]),
+        outContextBam(rhs.gH.outContextsBam[_threadId()])
+    {
+    }
+
+    static uint64_t _threadId()
     {
+    #ifdef _OPENMP
+        return omp_get_thread_num();
+    #else
+        return 0;
+    #endif
     }
 
     void init(uint64_t const _i)
     {
         i = _i;
 
-        if (options.doubleIndexing)
-        {
-            indexBeginQry = (length(gH.qrySeqs) / options.queryPart) * i;
-            indexEndQry = (i+1 == options.queryPart) // last interval
-                            ? length(gH.qrySeqs) // reach until end
-                            : (length(gH.qrySeqs) / options.queryPart) * (i+1);
-            // make sure different frames of one sequence in same interval
-            indexBeginQry -= (indexBeginQry % qNumFrames(blastProgram));
-            indexEndQry -= (indexEndQry % qNumFrames(blastProgram));
-        } else if (options.extensionMode == LambdaOptions::ExtensionMode::FULL_SIMD)
-        {
-            indexBeginQry = qNumFrames(blastProgram) * i * 10;
-            indexEndQry = _min(qNumFrames(blastProgram) * (i+1) * 10, length(gH.qrySeqs));
-        } else
-        {
-            indexBeginQry = qNumFrames(blastProgram) * i;
-            indexEndQry = qNumFrames(blastProgram) * (i+1);
-        }
+        indexBeginQry = gH.blockLimits[i];
+        indexEndQry   = gH.blockLimits[i + 1];
+        nextDupQry    = indexBeginQry / qNumFrames(blastProgram);
 
         clear(seeds);
         clear(seedIndex);
         matches.clear();
         seedRefs.clear();
         seedRanks.clear();
+        twoHitLast.clear();
+        preScoreCands.clear();
 //         stats.clear();
         statusStr.clear();
         statusStr.precision(2);
@@ -0,0 +1,221 @@
+// ==========================================================================
+//                                  lambda
+// ==========================================================================
+// Copyright (c) 2013-2019, Hannes Hauswedell <h2 @ fsfe.org>
+// Copyright (c) 2016-2019, Knut Reinert and Freie Universität Berlin
+// All rights reserved.
+//
+// This file is part of Lambda.
+//
+// Lambda is Free Software: you can redistribute it and/or modify it
+// under the terms found in the LICENSE[.md|.rst] file distributed
+// together with this file.
+//
+// Lambda is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+// ==========================================================================
+// search_memory.hpp: placement of the database in memory (NUMA, memory mapping)
+// ==========================================================================
+
+#ifndef LAMBDA_SEARCH_MEMORY_H_
+#define LAMBDA_SEARCH_MEMORY_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// The NUMA topology is read from sysfs and the memory policy is set with the raw system call, so that no
+// dependency on libnuma is required.
+
+// ============================================================================
+// Functions
+// ============================================================================
+
+// --------------------------------------------------------------------------
+// Function _parseNumaList()
+// --------------------------------------------------------------------------
+
+// parses the kernel's list format, e.g. "0-3,8-11"
+inline std::vector<unsigned>
+_parseNumaList(std::string const & list)
+{
+    std::vector<unsigned> ret;
+    std::istringstream s(list);
+    std::string range;
+    while (std::getline(s, range, ','))
+    {
+        if (range.find_first_not_of(" \t\n") == std::string::npos)
+            continue;
+
+        size_t const dash = range.find('-');
+        unsigned const first = std::stoul(range.substr(0, dash));
+        unsigned const last  = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+        for (unsigned i = first; i <= last; ++i)
+            ret.push_back(i);
+    }
+    return ret;
+}
+
+// --------------------------------------------------------------------------
+// Function numaNodeCpus()
+// --------------------------------------------------------------------------
+
+// one entry per NUMA node that has CPUs, containing the CPU ids; empty if the topology is unknown
+inline std::vector<std::vector<unsigned>>
+numaNodeCpus()
+{
+    std::vector<std::vector<unsigned>> ret;
+#if defined(__linux__)
+    std::ifstream nodesFile("/sys/devices/system/node/online");
+    std::string nodes;
+    if (!std::getline(nodesFile, nodes))
+        return ret;
+
+    for (unsigned node : _parseNumaList(nodes))
+    {
+        std::ifstream cpuFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string cpus;
+        if (std::getline(cpuFile, cpus) && !_parseNumaList(cpus).empty())
+            ret.push_back(_parseNumaList(cpus));
+    }
+#endif
+    return ret;
+}
+
+// --------------------------------------------------------------------------
+// Function numaInterleave()
+// --------------------------------------------------------------------------
+
+// (de)activate interleaving of all new memory pages of the calling thread across the online nodes
+inline bool
+numaInterleave(bool const on)
+{
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+    constexpr int mpolDefault    = 0; // MPOL_DEFAULT from <numaif.h>
+    constexpr int mpolInterleave = 3; // MPOL_INTERLEAVE from <numaif.h>
+    constexpr unsigned bitsPerWord = sizeof(unsigned long) * 8;
+
+    if (!on)
+        return syscall(SYS_set_mempolicy, mpolDefault, nullptr, 0) == 0;
+
+    std::ifstream nodesFile("/sys/devices/system/node/online");
+    std::string nodes;
+    if (!std::getline(nodesFile, nodes))
+        return false;
+
+    unsigned long mask[16] = {}; // up to 1024 nodes
+    for (unsigned node : _parseNumaList(nodes))
+        if (node < sizeof(mask) * 8)
+            mask[node / bitsPerWord] |= 1ul << (node % bitsPerWord);
+
+    return syscall(SYS_set_mempolicy, mpolInterleave, mask, sizeof(mask) * 8) == 0;
+#else
+    (void)on;
+    return false;
+#endif
+}
+
+// --------------------------------------------------------------------------
+// Function numaBindThread()
+// --------------------------------------------------------------------------
+
+// restrict the calling thread to the given CPUs
+inline bool
+numaBindThread(std::vector<unsigned> const & cpus)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+// --------------------------------------------------------------------------
+// Function adviseMappedDb()
+// --------------------------------------------------------------------------
+
+// Gives hints for all mappings of files in the index directory (these were created by SeqAn's MMap strings, so
+// MAP_POPULATE cannot be passed directly): read ahead, use huge pages where the kernel supports this for files,
+// optionally fault in all pages right away and optionally lock them in memory. Returns the number of bytes mapped;
+// lockFailed is set if mlock() was refused (usually because of RLIMIT_MEMLOCK).
+inline uint64_t
+adviseMappedDb(std::string const & indexDir, bool const prefault, bool const lock, bool & lockFailed)
+{
+    uint64_t mapped = 0;
+    lockFailed = false;
+#if defined(__linux__)
+    char * dir = realpath(indexDir.c_str(), nullptr);
+    if (dir == nullptr)
+        return 0;
+    std::string const prefix = std::string(dir) + "/";
+    free(dir);
+
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line))
+    {
+        // format: begin-end perms offset dev inode path
+        size_t const pathPos = line.find('/');
+        if ((pathPos == std::string::npos) || (line.compare(pathPos, prefix.size(), prefix) != 0))
+            continue;
+
+        uintptr_t begin = 0;
+        uintptr_t end = 0;
+        if (std::sscanf(line.c_str(), "%lx-%lx", &begin, &end) != 2)
+            continue;
+
+        void * addr = reinterpret_cast<void *>(begin);
+        size_t const len = end - begin;
+        mapped += len;
+
+        madvise(addr, len, MADV_WILLNEED);
+    #ifdef MADV_HUGEPAGE
+        madvise(addr, len, MADV_HUGEPAGE);
+    #endif
+
+        if (prefault)
+        {
+        #ifdef MADV_POPULATE_READ
+            if (madvise(addr, len, MADV_POPULATE_READ) != 0)
+        #endif
+            {
+                // touch one byte per page, this is what MAP_POPULATE would do
+                long const pageSize = sysconf(_SC_PAGESIZE);
+                char const volatile * p = reinterpret_cast<char const volatile *>(begin);
+                uint64_t const nPages = len / pageSize;
+                SEQAN_OMP_PRAGMA(parallel for schedule(static))
+                for (uint64_t i = 0; i < nPages; ++i)
+                    (void)p[i * pageSize];
+            }
+        }
+
+        if (lock && (mlock(addr, len) != 0))
+            lockFailed = true;
+    }
+#else
+    (void)indexDir;
+    (void)prefault;
+    (void)lock;
+#endif
+    return mapped;
+}
+
+#endif // LAMBDA_SEARCH_MEMORY_H_
@@ -22,6 +22,8 @@
 #ifndef LAMBDA_SEARCH_MISC_H_
 #define LAMBDA_SEARCH_MISC_H_
 
+#include <algorithm>
+#include <limits>
 #include <vector>
 
 using namespace seqan;
@@ -44,18 +46,89 @@ struct QueryException : public std::runtime_error
 // Seeding related
 // ============================================================================
 
+// LSD radix sort into the order of Match::operator<, i.e. by qryId, subjId, qryStart, subjStart and length.
+// Every field is sorted relative to its minimum in digits of 11 bits, least significant first; passes in which all
+// matches have the same digit are skipped, so only a few passes remain for the value ranges of one block.
+template <typename TAlph>
+inline void
+radixSortMatches(std::vector<Match<TAlph>> & matches)
+{
+    using TMatch = Match<TAlph>;
+    constexpr unsigned digitBits = 11;
+    constexpr uint64_t nBuckets  = 1ull << digitBits;
+
+    if (matches.size() < 256)
+    {
+        std::sort(matches.begin(), matches.end());
+        return;
+    }
+
+    auto field = [] (TMatch const & m, unsigned const f) -> uint64_t
+    {
+        switch (f)
+        {
+            case 0:  return m.qryId;
+            case 1:  return m.subjId;
+            case 2:  return m.qryStart;
+            case 3:  return m.subjStart;
+            default: return m.length;
+        }
+    };
+
+    std::vector<TMatch> buffer(matches.size());
+    std::vector<uint64_t> counts(nBuckets);
+
+    for (unsigned f = 5; f > 0; --f)
+    {
+        uint64_t min = std::numeric_limits<uint64_t>::max();
+        uint64_t max = 0;
+        for (TMatch const & m : matches)
+        {
+            min = std::min(min, field(m, f - 1));
+            max = std::max(max, field(m, f - 1));
+        }
+
+        for (unsigned shift = 0; (shift < 64) && (((max - min) >> shift) > 0); shift += digitBits)
+        {
+            auto digit = [&] (TMatch const & m) { return ((field(m, f - 1) - min) >> shift) & (nBuckets - 1); };
+
+            std::fill(counts.begin(), counts.end(), 0);
+            for (TMatch const & m : matches)
+                ++counts[digit(m)];
+
+            if (counts[digit(matches.front())] == matches.size()) // all in one bucket
+                continue;
+
+            uint64_t sum = 0;
+            for (uint64_t & c : counts)
+            {
+                uint64_t const n = c;
+                c = sum;
+                sum += n;
+            }
+
+            for (TMatch const & m : matches)
+                buffer[counts[digit(m)]++] = m;
+            std::swap(matches, buffer);
+        }
+    }
+}
+
+// Sort the matches, and for queries with more than maxMatches hits move the subjects with the most hits to the front
+// of the query's matches, so that they are extended first. Blocks contain multiple queries, so the matches of a query
+// always stay together.
 template <typename TGH, typename TAlph>
 inline void
 myHyperSortSingleIndex(std::vector<Match<TAlph>> & matches,
-                       bool const doubleIndexing,
+                       uint64_t const maxMatches,
                        TGH const &)
 {
     using TId = typename Match<TAlph>::TQId;
 
     // regular sort
-    std::sort(matches.begin(), matches.end());
+    radixSortMatches(matches);
 
-    //                    trueQryId, begin,    end
+    //                    trueQryId, begin,    end     [in the order of matches]
     std::vector<std::tuple<TId, TId, TId>> intervals;
     for (TId i = 1; i <= length(matches); ++i)
     {
@@ -77,22 +150,18 @@ myHyperSortSingleIndex(std::vector<Match<TAlph>> & matches,
         }
     }
 
-    if (doubleIndexing)
-    {
-        // sort by trueQryId, then lengths of interval
-        std::sort(intervals.begin(), intervals.end(),
-                [] (std::tuple<TId, TId, TId> const & i1,
-                    std::tuple<TId, TId, TId> const & i2)
-        {
-            return (std::get<0>(i1) != std::get<0>(i2))
-                    ? (std::get<0>(i1) < std::get<0>(i2))
-                    : ((std::get<2>(i1) - std::get<1>(i1))
-                     > (std::get<2>(i2) - std::get<1>(i2)));
-        });
-    } else
+    // new order of the intervals: the intervals are already sorted by trueQryId; those of queries with more than
+    // maxMatches matches are sorted by length
+    std::vector<std::tuple<TId, TId, TId>> order = intervals;
+    for (auto qBegin = order.begin(), qEnd = qBegin; qBegin != order.end(); qBegin = qEnd)
     {
-        // sort by lengths of interval, since trueQryId is the same anyway
-        std::sort(intervals.begin(), intervals.end(),
+        while ((qEnd != order.end()) && (std::get<0>(*qEnd) == std::get<0>(*qBegin)))
+            ++qEnd;
+
+        if (std::get<2>(*std::prev(qEnd)) - std::get<1>(*qBegin) <= maxMatches)
+            continue;
+
+        std::sort(qBegin, qEnd,
                 [] (std::tuple<TId, TId, TId> const & i1,
                     std::tuple<TId, TId, TId> const & i2)
         {
@@ -101,20 +170,42 @@ myHyperSortSingleIndex(std::vector<Match<TAlph>> & matches,
         });
     }
 
-    std::vector<Match<TAlph>> tmpVector;
-    tmpVector.resize(matches.size());
+    // new begin of every interval; intervals are found by their old ends
+    std::vector<TId> newBegins(intervals.size());
+    std::vector<TId> oldEnds(intervals.size());
+    for (size_t k = 0; k < intervals.size(); ++k)
+        oldEnds[k] = std::get<2>(intervals[k]);
 
     TId newIndex = 0;
-    for (auto const & i : intervals)
+    for (auto const & i : order)
+    {
+        size_t const k = std::upper_bound(oldEnds.begin(), oldEnds.end(), std::get<1>(i)) - oldEnds.begin();
+        newBegins[k] = newIndex;
+        newIndex += std::get<2>(i) - std::get<1>(i);
+    }
+
+    auto dest = [&] (TId const j)
+    {
+        size_t const k = std::upper_bound(oldEnds.begin(), oldEnds.end(), j) - oldEnds.begin();
+        return newBegins[k] + (j - std::get<1>(intervals[k]));
+    };
+
+    // apply the permutation in place by following its cycles
+    std::vector<bool> placed(matches.size(), false);
+    for (TId i = 0; i < length(matches); ++i)
     {
-        TId limit = std::get<2>(i);
-        for (TId j = std::get<1>(i); j < limit; ++j)
+        if (placed[i])
+            continue;
+
+        Match<TAlph> carry = matches[i];
+        TId j = i;
+        do
         {
-            tmpVector[newIndex] = matches[j];
-            newIndex++;
-        }
+            j = dest(j);
+            std::swap(carry, matches[j]);
+            placed[j] = true;
+        } while (j != i);
     }
-    std::swap(tmpVector, matches);
 }
 
 
@@ -25,6 +25,9 @@
 #include <cstdio>
 #include <unistd.h>
 #include <bitset>
+#include <numeric>
+#include <string>
+#include <vector>
 
 #include <seqan/basic.h>
 #include <seqan/translation.h>
@@ -53,6 +56,12 @@ struct LambdaOptions : public SharedOptions
 {
 
     std::string     queryFile;
+    uint64_t        queryChunkSize = 0; // 0 = whole file at once
+
+    std::string     serverSocket; // non-empty iff running as server
+
+    bool            collapseDuplicates = true; // search identical queries only once
+    bool            maskQueries = false; // mask low-complexity regions of the queries
 
     AlphabetEnum    qryOrigAlphabet;
     bool            revComp     = true;
@@ -69,6 +78,12 @@ struct LambdaOptions : public SharedOptions
 
     unsigned        queryPart = 0;
 
+    bool            numaInterleave = false;
+
+    bool            dbStorageFromIndex = true; // use storage recorded in the index, otherwise dbMMap
+    bool            dbPrefault  = true;
+    bool            dbLock      = false;
+
 //     bool            semiGlobal;
 
     bool            doubleIndexing = false;
@@ -82,6 +97,8 @@ struct LambdaOptions : public SharedOptions
     unsigned        seedOffset      = 0;
     unsigned        minSeedLength   = 0;
     bool            seedDeltaIncreasesLength = true;
+    std::vector<std::string> seedPatterns; // spaced seeds, e.g. "1101011"; empty = contiguous seeds
+    uint64_t        seedCacheSize   = 0; // max. entries in the seed cache, 0 = off
 
 //     unsigned int    minSeedEVal     = 0;
 //     double          minSeedBitS     = -1;
@@ -119,6 +136,7 @@ struct LambdaOptions : public SharedOptions
 
     int             preScoring = 0; // 0 = off, 1 = seed, 2 = region (
     double          preScoringThresh    = 0.0;
+    unsigned        twoHitWindow        = 0; // 0 = off
 
     LambdaOptions() :
         SharedOptions()
@@ -137,17 +155,24 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
     std::string programName = "lambda2 " + std::string(argv[0]);
 
     // this is important for option handling:
-    if (std::string(argv[0]) == "searchn")
+    if ((std::string(argv[0]) == "searchn") || (std::string(argv[0]) == "serven"))
         options.blastProgram = BlastProgram::BLASTN;
 
+    bool const isServer = (std::string(argv[0]) == "servep") || (std::string(argv[0]) == "serven");
+
     ArgumentParser parser(programName);
     // Set short description, version, and date.
     setShortDescription(parser, "the Local Aligner for Massive Biological DatA");
 
     // Define usage line and long description.
-    addUsageLine(parser, "[\\fIOPTIONS\\fP] \\fI-q QUERY.fasta\\fP "
-                         "\\fI-i INDEX.lambda\\fP "
-                         "[\\fI-o output.m8\\fP]");
+    if (isServer)
+        addUsageLine(parser, "[\\fIOPTIONS\\fP] \\fI--socket PATH\\fP "
+                             "\\fI-i INDEX.lambda\\fP "
+                             "[\\fI-o format.m8\\fP]");
+    else
+        addUsageLine(parser, "[\\fIOPTIONS\\fP] \\fI-q QUERY.fasta\\fP "
+                             "\\fI-i INDEX.lambda\\fP "
+                             "[\\fI-o output.m8\\fP]");
 
     sharedSetup(parser);
 
@@ -171,7 +196,41 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
         ArgParseArgument::INPUT_FILE,
         "IN"));
     setValidValues(parser, "query", getFileExtensions(SeqFileIn()));
-    setRequired(parser, "q");
+    if (isServer)
+        hideOption(parser, "query"); // queries are received through the socket
+    else
+        setRequired(parser, "q");
+
+    addOption(parser, ArgParseOption("", "query-chunk-size",
+        "Read, translate and search the queries in chunks of this many sequences instead of loading the whole file "
+        "up front; the next chunk is read while the current one is searched (0 -> load whole file).",
+        ArgParseArgument::INTEGER));
+    setDefaultValue(parser, "query-chunk-size", "0");
+    setMinValue(parser, "query-chunk-size", "0");
+    setAdvanced(parser, "query-chunk-size");
+
+    addOption(parser, ArgParseOption("", "collapse-duplicates",
+        "Search queries with identical sequences only once and report the results for all of them (when streaming, "
+        "within each chunk).",
+        ArgParseArgument::BOOL));
+    setDefaultValue(parser, "collapse-duplicates", "on");
+    setAdvanced(parser, "collapse-duplicates");
+
+    addOption(parser, ArgParseOption("", "mask-queries",
+        "Mask low-complexity regions of the queries (SEG for protein, DUST for nucleotide sequences); no seeds start "
+        "inside masked regions, but extensions may still cover them.",
+        ArgParseArgument::BOOL));
+    setDefaultValue(parser, "mask-queries", "off");
+    setAdvanced(parser, "mask-queries");
+
+    if (isServer)
+    {
+        addOption(parser, ArgParseOption("", "socket",
+            "Path of the unix domain socket to listen on for search jobs.",
+            ArgParseArgument::OUTPUT_FILE,
+            "PATH"));
+        setRequired(parser, "socket");
+    }
 
     if (options.blastProgram != BlastProgram::BLASTN)
     {
@@ -201,6 +260,27 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
     setRequired(parser, "index");
     setValidValues(parser, "index", ".lambda");
 
+    addOption(parser, ArgParseOption("", "db-storage",
+        "How to load the database: \"alloc\" reads it into private memory, \"mmap\" maps the files so that "
+        "the memory is shared via the page cache with other lambda processes on the same host. "
+        "\"index\" uses what was chosen when creating the index (alloc for older indexes).",
+        ArgParseArgument::STRING));
+    setValidValues(parser, "db-storage", "index alloc mmap");
+    setDefaultValue(parser, "db-storage", "index");
+    setAdvanced(parser, "db-storage");
+
+    addOption(parser, ArgParseOption("", "db-prefault",
+        "When memory-mapped, fault in the whole database at start instead of on first access.",
+        ArgParseArgument::BOOL));
+    setDefaultValue(parser, "db-prefault", "on");
+    setAdvanced(parser, "db-prefault");
+
+    addOption(parser, ArgParseOption("", "db-lock",
+        "When memory-mapped, lock the database in memory so it is never paged out (subject to RLIMIT_MEMLOCK).",
+        ArgParseArgument::BOOL));
+    setDefaultValue(parser, "db-lock", "off");
+    setAdvanced(parser, "db-lock");
+
     addSection(parser, "Output Options");
     addOption(parser, ArgParseOption("o", "output",
         "File to hold reports on hits (.m* are blastall -m* formats; .m8 is tab-separated, .m9 is tab-separated with "
@@ -324,6 +404,16 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
 #endif
     setAdvanced(parser, "threads");
 
+    addOption(parser, ArgParseOption("", "numa",
+        "Memory placement on machines with multiple NUMA nodes (sockets). \"interleave\" spreads the index and the "
+        "subject sequences evenly across all nodes and binds the search threads to the nodes in turn, so that "
+        "all threads see the same mix of local and remote memory. \"none\" leaves placement to the "
+        "operating system.",
+        ArgParseArgument::STRING));
+    setValidValues(parser, "numa", "none interleave");
+    setDefaultValue(parser, "numa", "none");
+    setAdvanced(parser, "numa");
+
 #ifdef LAMBDA_LEGACY_PATHS
     addOption(parser, ArgParseOption("", "query-index-type",
         "controls double-indexing.",
@@ -375,12 +465,13 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
     setMaxValue(parser, "seed-offset", "50");
 
     addOption(parser, ArgParseOption("", "seed-delta",
-        "maximum seed distance.",
+        "maximum seed distance. More than one error is searched with search schemes (best with bi-directional "
+        "indexes) and seeds of fixed length; adaptive seeding does not apply then.",
         ArgParseArgument::INTEGER));
     setDefaultValue(parser, "seed-delta", "1");
     setAdvanced(parser, "seed-delta");
     setMinValue(parser, "seed-delta", "0");
-    setMaxValue(parser, "seed-delta", "1");
+    setMaxValue(parser, "seed-delta", "3");
 
     addOption(parser, ArgParseOption("", "seed-delta-increases-length",
         "Seed delta increases the min. seed length (for affected seeds).",
@@ -394,6 +485,23 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
     setDefaultValue(parser, "seed-half-exact", "on");
     setAdvanced(parser, "seed-half-exact");
 
+    addOption(parser, ArgParseOption("", "seed-patterns",
+        "Use spaced seeds instead of contiguous seeds. A comma-separated list of patterns where 1 is a position that "
+        "has to match and 0 one that may differ, e.g. 11011011,111001011. Patterns are searched together, seed-offset "
+        "still applies; adaptive seeding and seed-delta do not.",
+        ArgParseArgument::STRING));
+    setAdvanced(parser, "seed-patterns");
+
+    addOption(parser, ArgParseOption("", "seed-cache-size",
+        "Number of seed search results that are cached and shared between queries. Only applies to seeds of fixed "
+        "length (spaced seeds, seed-delta > 1 or adaptive-seeding off). Enable it if the queries are highly similar "
+        "or redundant (e.g. reads of the same sample or many variants of a protein), otherwise the lookups only add "
+        "time. 0 to deactivate.",
+        ArgParseArgument::INTEGER));
+    setDefaultValue(parser, "seed-cache-size", "0");
+    setMinValue(parser, "seed-cache-size", "0");
+    setAdvanced(parser, "seed-cache-size");
+
     addOption(parser, ArgParseOption("", "seed-gravity",
         "Seeds closer than this are merged into region (if unset = "
         "seed-length).",
@@ -427,6 +535,15 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
     setMaxValue(parser, "pre-scoring-threshold", "20");
     setAdvanced(parser, "pre-scoring-threshold");
 
+    addOption(parser, ArgParseOption("", "two-hit-window",
+        "only extend a hit if a second, non-overlapping hit on the same diagonal starts at most this many "
+        "positions away (0 -> off; BLAST uses 40 for proteins).",
+        ArgParseArgument::INTEGER));
+    setDefaultValue(parser, "two-hit-window", "0");
+    setMinValue(parser, "two-hit-window", "0");
+    setMaxValue(parser, "two-hit-window", "1000");
+    setAdvanced(parser, "two-hit-window");
+
     addOption(parser, ArgParseOption("", "filter-putative-duplicates",
         "filter hits that will likely duplicate a match already found.",
         ArgParseArgument::BOOL));
@@ -531,6 +648,18 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
     setDefaultValue(parser, "extension-mode", "auto");
     setAdvanced(parser, "extension-mode");
 
+    if (isServer)
+    {
+        addTextSection(parser, "Server mode");
+        addText(parser, "The index is loaded once and search jobs are then received through the unix domain socket "
+                        "given by --socket. For every job a client connects, writes the query sequences (FASTA or "
+                        "FASTQ, uncompressed) and shuts down the writing end of its connection. The results are sent "
+                        "back on the same connection in the format selected by the extension of --output (.m0, .m8, "
+                        ".m9 or .sam); no output file is created. Jobs are processed one after another, each with all "
+                        "threads. SIGINT or SIGTERM stop the server.");
+        addText(parser, "Example client: socat -t 3600 - UNIX-CONNECT:PATH < queries.fasta > results.m8");
+    }
+
     addTextSection(parser, "Tuning");
     addText(parser, "Tuning the seeding parameters and (de)activating alphabet "
                     "reduction has a strong "
@@ -576,6 +705,15 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
 
     // Extract option values.
     getOptionValue(options.queryFile, parser, "query");
+    getOptionValue(options.queryChunkSize, parser, "query-chunk-size");
+    getOptionValue(options.collapseDuplicates, parser, "collapse-duplicates");
+    getOptionValue(options.maskQueries, parser, "mask-queries");
+
+    if (isServer)
+    {
+        getOptionValue(options.serverSocket, parser, "socket");
+        options.queryChunkSize = 0;
+    }
 
     if (options.blastProgram == BlastProgram::BLASTN)
     {
@@ -613,6 +751,12 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
 
     getOptionValue(options.indexDir, parser, "index");
 
+    getOptionValue(buffer, parser, "db-storage");
+    options.dbStorageFromIndex = (buffer == "index");
+    options.dbMMap = (buffer == "mmap");
+    getOptionValue(options.dbPrefault, parser, "db-prefault");
+    getOptionValue(options.dbLock, parser, "db-lock");
+
     getOptionValue(options.output, parser, "output");
     buffer = options.output;
     if (endsWith(buffer, ".gz"))
@@ -757,6 +901,12 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
 
     getOptionValue(options.maxSeedDist, parser, "seed-delta");
 
+    if (options.seedLength <= options.maxSeedDist)
+    {
+        std::cerr << "ERROR: The seed-length must be larger than the seed-delta.\n";
+        return ArgumentParser::PARSE_ERROR;
+    }
+
     if (options.maxSeedDist == 0)
     {
         // the whole seed is exact, so it is also half-exact :)
@@ -771,6 +921,27 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
 
     getOptionValue(options.seedDeltaIncreasesLength, parser, "seed-delta-increases-length");
 
+    getOptionValue(options.seedCacheSize, parser, "seed-cache-size");
+
+    clear(buffer);
+    getOptionValue(buffer, parser, "seed-patterns");
+    options.seedPatterns.clear();
+    for (size_t b = 0, e = 0; b < buffer.size(); b = e + 1)
+    {
+        e = std::min(buffer.find(',', b), buffer.size());
+        std::string const pattern = buffer.substr(b, e - b);
+
+        if ((pattern.size() < 3) || (pattern.size() > 50) ||
+            (pattern.find_first_not_of("01") != std::string::npos) ||
+            (pattern.front() != '1') || (pattern.back() != '1'))
+        {
+            std::cerr << "ERROR: Seed pattern \"" << pattern << "\" is invalid. Patterns consist of 3 to 50 "
+                      << "characters that are 0 or 1, and begin and end with 1.\n";
+            return ArgumentParser::PARSE_ERROR;
+        }
+        options.seedPatterns.push_back(pattern);
+    }
+
     getOptionValue(options.eCutOff, parser, "e-value");
     getOptionValue(options.idCutOff, parser, "percent-identity");
 
@@ -841,6 +1012,8 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
 //         options.preScoring = 1;
 
     getOptionValue(options.preScoringThresh, parser, "pre-scoring-threshold");
+
+    getOptionValue(options.twoHitWindow, parser, "two-hit-window");
 //     if (options.preScoring == 0)
 //         options.preScoringThresh = 4;
 
@@ -848,6 +1021,9 @@ parseCommandLine(LambdaOptions & options, int argc, char const ** argv)
     getOptionValue(numbuf, parser, "num-matches");
     options.maxMatches = static_cast<unsigned long>(numbuf);
 
+    getOptionValue(buffer, parser, "numa");
+    options.numaInterleave = (buffer == "interleave");
+
     getOptionValue(buffer, parser, "extension-mode");
     if (buffer == "fullSIMD")
     {
@@ -900,7 +1076,16 @@ printOptions(LambdaOptions const & options)
     std::cout << "OPTIONS\n"
               << " INPUT\n"
               << "  query file:               " << options.queryFile << "\n"
+              << "  server socket:            " << (options.serverSocket.empty()
+                                                    ? std::string("n/a")
+                                                    : options.serverSocket) << "\n"
+              << "  query chunk size:         " << (options.queryChunkSize
+                                                    ? std::to_string(options.queryChunkSize)
+                                                    : std::string("whole file")) << "\n"
               << "  index directory:          " << options.indexDir << "\n"
+              << "  database storage:         " << (options.dbMMap
+                                                    ? std::string("mmap") + (options.dbLock ? ", locked" : "")
+                                                    : std::string("alloc")) << "\n"
               << "  db index type:            " << _indexEnumToName(options.dbIndexType) << "\n"
               << " OUTPUT (file)\n"
               << "  output file:              " << options.output << "\n"
@@ -918,6 +1103,7 @@ printOptions(LambdaOptions const & options)
               << " GENERAL\n"
               << "  double indexing:          " << options.doubleIndexing << "\n"
               << "  threads:                  " << uint(options.threads) << "\n"
+              << "  NUMA placement:           " << (options.numaInterleave ? "interleave" : "none") << "\n"
               << "  query partitions:         " << (options.doubleIndexing
                                                     ? std::to_string(options.queryPart)
                                                     : std::string("n/a")) << "\n"
@@ -947,6 +1133,15 @@ printOptions(LambdaOptions const & options)
               << "  seed delta length inc.:   " << (options.seedDeltaIncreasesLength
                                                     ? std::string("on")
                                                     : std::string("off")) << "\n"
+              << "  seed patterns:            " << (options.seedPatterns.empty()
+                                                    ? std::string("none (contiguous)")
+                                                    : std::accumulate(std::next(options.seedPatterns.begin()),
+                                                                      options.seedPatterns.end(),
+                                                                      options.seedPatterns.front(),
+                                                                      [] (std::string const & a,
+                                                                          std::string const & b)
+                                                                      { return a + "," + b; })) << "\n"
+              << "  seed cache size:          " << options.seedCacheSize << "\n"
               << " MISCELLANEOUS HEURISTICS\n"
               << "  pre-scoring:              " << (options.preScoring
                                                     ? std::string("on")
@@ -960,6 +1155,12 @@ printOptions(LambdaOptions const & options)
                                                     ? std::to_string(
                                                        options.preScoringThresh)
                                                     : std::string("n/a")) << "\n"
+              << "  query masking:            " << (options.maskQueries
+                                                    ? std::string("on")
+                                                    : std::string("off")) << "\n"
+              << "  two-hit window:           " << (options.twoHitWindow
+                                                    ? std::to_string(options.twoHitWindow)
+                                                    : std::string("off")) << "\n"
               << "  putative-abundancy:       " << (options.filterPutativeAbundant
                                                     ? std::string("on")
                                                     : std::string("off")) << "\n"
@@ -1028,12 +1229,6 @@ printOptions(LambdaOptions const & options)
               << "on\n"
     #else
               << "off\n"
-    #endif
-              << "  mmapped_db:               "
-    #if defined(LAMBDA_MMAPPED_DB)
-              << "on\n"
-    #else
-              << "off\n"
     #endif
               << "  lingaps_opt:              "
     #if defined(LAMBDA_LINGAPS_OPT)
@@ -22,8 +22,14 @@
 #ifndef LAMBDA_SEARCH_OUTPUT_H_
 #define LAMBDA_SEARCH_OUTPUT_H_
 
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+
 #include <seqan/blast.h>
 #include <seqan/bam_io.h>
+#include <seqan/parallel.h>
 
 using namespace seqan;
 
@@ -300,13 +306,13 @@ blastMatchTwoCigar(TCigar & dnaCigar,
 // Function myWriteHeader()
 // ----------------------------------------------------------------------------
 
+// the output file has already been opened
 template <typename TGH, typename TLambdaOptions>
 inline void
-myWriteHeader(TGH & globalHolder, TLambdaOptions const & options)
+_myWriteHeaderImpl(TGH & globalHolder, TLambdaOptions const & options)
 {
     if (options.outFileFormat == 0) // BLAST
     {
-        open(globalHolder.outfile, toCString(options.output));
         context(globalHolder.outfile).fields = options.columns;
         auto & versionString = context(globalHolder.outfile).versionString;
         clear(versionString);
@@ -321,37 +327,41 @@ myWriteHeader(TGH & globalHolder, TLambdaOptions const & options)
         writeHeader(globalHolder.outfile);
     } else // SAM or BAM
     {
-        open(globalHolder.outfileBam, toCString(options.output));
         auto & context          = seqan::context(globalHolder.outfileBam);
         auto & subjSeqLengths   = contigLengths(context);
         auto & subjIds          = contigNames(context);
 
-        // set sequence lengths
-        if (sIsTranslated(TGH::blastProgram))
-        {
-            //TODO can we get around a copy?
-            subjSeqLengths = prefix(globalHolder.untransSubjSeqLengths, length(globalHolder.untransSubjSeqLengths) - 1);
-        } else
+        // a server writes a header for every job, but the reference information only has to be set once
+        if (length(subjIds) == 0)
         {
-            // compute lengths ultra-fast
-            resize(subjSeqLengths, length(globalHolder.subjSeqs));
+            // set sequence lengths
+            if (sIsTranslated(TGH::blastProgram))
+            {
+                //TODO can we get around a copy?
+                subjSeqLengths = prefix(globalHolder.untransSubjSeqLengths,
+                                        length(globalHolder.untransSubjSeqLengths) - 1);
+            } else
+            {
+                // compute lengths ultra-fast
+                resize(subjSeqLengths, length(globalHolder.subjSeqs));
 #ifdef __clang__
-            SEQAN_OMP_PRAGMA(parallel for)
+                SEQAN_OMP_PRAGMA(parallel for)
 #else
-            SEQAN_OMP_PRAGMA(parallel for simd)
+                SEQAN_OMP_PRAGMA(parallel for simd)
 #endif
-            for (unsigned i = 0; i < length(subjSeqLengths); ++i)
-                subjSeqLengths[i] = globalHolder.subjSeqs.limits[i+1] - globalHolder.subjSeqs.limits[i];
+                for (unsigned i = 0; i < length(subjSeqLengths); ++i)
+                    subjSeqLengths[i] = globalHolder.subjSeqs.limits[i+1] - globalHolder.subjSeqs.limits[i];
+            }
+            // set namestore
+            resize(subjIds, length(globalHolder.subjIds));
+            SEQAN_OMP_PRAGMA(parallel for)
+            for (unsigned i = 0; i < length(globalHolder.subjIds); ++i)
+                subjIds[i] = prefix(globalHolder.subjIds[i],
+                                    std::find(begin(globalHolder.subjIds[i], Standard()),
+                                              end(globalHolder.subjIds[i], Standard()),
+                                              ' ')
+                                    - begin(globalHolder.subjIds[i], Standard()));
         }
-        // set namestore
-        resize(subjIds, length(globalHolder.subjIds));
-        SEQAN_OMP_PRAGMA(parallel for)
-        for (unsigned i = 0; i < length(globalHolder.subjIds); ++i)
-            subjIds[i] = prefix(globalHolder.subjIds[i],
-                                std::find(begin(globalHolder.subjIds[i], Standard()),
-                                          end(globalHolder.subjIds[i], Standard()),
-                                          ' ')
-                                - begin(globalHolder.subjIds[i], Standard()));
 
         typedef BamHeaderRecord::TTag   TTag;
 
@@ -424,23 +434,272 @@ myWriteHeader(TGH & globalHolder, TLambdaOptions const & options)
             writeHeader(globalHolder.outfileBam, header);
         }
     }
+
+    // the contexts are complete now; every search thread formats its records with its own copy, which is made once
+    // here instead of for every chunk of queries (the BAM context holds the names of all subjects)
+    globalHolder.outContexts.assign(std::max<uint64_t>(options.threads, 1), context(globalHolder.outfile));
+    globalHolder.outContextsBam.assign(std::max<uint64_t>(options.threads, 1), context(globalHolder.outfileBam));
+}
+
+template <typename TGH, typename TLambdaOptions>
+inline void
+myWriteHeader(TGH & globalHolder, TLambdaOptions const & options)
+{
+    if (options.outFileFormat == 0) // BLAST
+        open(globalHolder.outfile, toCString(options.output));
+    else // SAM or BAM
+        open(globalHolder.outfileBam, toCString(options.output));
+
+    _myWriteHeaderImpl(globalHolder, options);
+}
+
+// write to a stream instead of options.output (used by the server; no compression, no BAM)
+template <typename TGH, typename TLambdaOptions>
+inline void
+myWriteHeader(TGH & globalHolder, TLambdaOptions const & options, std::ostream & stream)
+{
+    if (options.outFileFormat == 0) // BLAST
+        open(globalHolder.outfile, stream, typename TGH::TOutFormat());
+    else // SAM
+        open(globalHolder.outfileBam, stream, Sam());
+
+    _myWriteHeaderImpl(globalHolder, options);
+}
+
+// ----------------------------------------------------------------------------
+// Function myStartWriter()
+// ----------------------------------------------------------------------------
+
+// the writer thread is the only one touching the output file (and thereby also does the compression).
+// It writes the blocks in order of their index, so the output is the same for every run and number of threads;
+// chunks of later blocks are kept until all earlier blocks are complete.
+template <typename TGH, typename TLambdaOptions>
+inline std::thread
+myStartWriter(TGH & globalHolder, TLambdaOptions const & options, std::exception_ptr & error)
+{
+    globalHolder.outQueueClosed = false;
+    globalHolder.outNextBlock = 0;
+
+    return std::thread([&globalHolder, &options, &error] ()
+    {
+        auto writeBuffer = [&] (typename TGH::TOutBuffer const & buf)
+        {
+            if (options.outFileFormat == 0) // BLAST
+                write(globalHolder.outfile.iter, buf);
+            else // SAM or BAM
+                write(globalHolder.outfileBam.iter, buf);
+        };
+
+        // the records of a duplicate were formatted together with those of the first query with the same
+        // sequence, which is in the same or an earlier block, so they are complete when the chunk is written
+        auto writeChunk = [&] (OutputChunk & c)
+        {
+            if (c.duplicate == OutputChunk::noDuplicate)
+            {
+                writeBuffer(c.buffer);
+            } else
+            {
+                writeBuffer(globalHolder.qryDupRecords[c.duplicate]);
+                clear(globalHolder.qryDupRecords[c.duplicate]);
+                shrinkToFit(globalHolder.qryDupRecords[c.duplicate]);
+            }
+        };
+
+        // block index -> (chunks received so far, block complete?)
+        std::map<uint64_t, std::pair<std::vector<OutputChunk>, bool>> pending;
+        uint64_t next = 0;
+
+        OutputChunk chunk;
+        try
+        {
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(globalHolder.outMutex);
+                    globalHolder.outQueueChanged.wait(lock, [&globalHolder] ()
+                    {
+                        return !globalHolder.outQueue.empty() || globalHolder.outQueueClosed;
+                    });
+                    if (globalHolder.outQueue.empty()) // closed and drained
+                        break;
+                    chunk = std::move(globalHolder.outQueue.front());
+                    globalHolder.outQueue.pop_front();
+                }
+
+                if (chunk.block != next)
+                {
+                    auto & p = pending[chunk.block];
+                    p.second = chunk.last;
+                    p.first.push_back(std::move(chunk));
+                    continue;
+                }
+
+                writeChunk(chunk);
+                bool advance = chunk.last;
+                while (advance)
+                {
+                    ++next;
+                    auto it = pending.find(next);
+                    if (it == pending.end())
+                        break;
+                    for (auto & c : it->second.first)
+                        writeChunk(c);
+                    advance = it->second.second;
+                    pending.erase(it); // remaining chunks of an incomplete block are written on arrival
+                }
+
+                if (next != globalHolder.outNextBlock)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(globalHolder.outMutex);
+                        globalHolder.outNextBlock = next;
+                    }
+                    globalHolder.outWindowChanged.notify_all();
+                }
+            }
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+
+            // nothing will be written anymore, don't keep the search threads waiting (see myStopWriter())
+            {
+                std::lock_guard<std::mutex> lock(globalHolder.outMutex);
+                globalHolder.outNextBlock = std::numeric_limits<uint64_t>::max() / 2;
+            }
+            globalHolder.outWindowChanged.notify_all();
+        }
+    });
+}
+
+// ----------------------------------------------------------------------------
+// Function myStopWriter()
+// ----------------------------------------------------------------------------
+
+template <typename TGH>
+inline void
+myStopWriter(TGH & globalHolder, std::thread & writer, std::exception_ptr const & error)
+{
+    {
+        std::lock_guard<std::mutex> lock(globalHolder.outMutex);
+        globalHolder.outQueueClosed = true;
+    }
+    globalHolder.outQueueChanged.notify_one();
+    writer.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// ----------------------------------------------------------------------------
+// Function myWaitForOutputWindow()
+// ----------------------------------------------------------------------------
+
+// number of blocks that may be in flight ahead of the writer
+template <typename TLambdaOptions>
+inline uint64_t
+myOutputWindow(TLambdaOptions const & options)
+{
+    return std::max<uint64_t>(16, 4 * options.threads);
+}
+
+// don't start a block too far ahead of the writer, otherwise the kept-back output could grow without bounds
+template <typename TGH, typename TLambdaOptions>
+inline void
+myWaitForOutputWindow(TGH & globalHolder, TLambdaOptions const & options, uint64_t const block)
+{
+    uint64_t const window = myOutputWindow(options);
+    std::unique_lock<std::mutex> lock(globalHolder.outMutex);
+    globalHolder.outWindowChanged.wait(lock, [&globalHolder, window, block] ()
+    {
+        return block < globalHolder.outNextBlock + window;
+    });
+}
+
+// ----------------------------------------------------------------------------
+// Function myPushChunk()
+// ----------------------------------------------------------------------------
+
+// hand a chunk to the writer thread and wake it up
+template <typename TGH>
+inline void
+myPushChunk(TGH & globalHolder, OutputChunk && chunk)
+{
+    {
+        std::lock_guard<std::mutex> lock(globalHolder.outMutex);
+        globalHolder.outQueue.push_back(std::move(chunk));
+    }
+    globalHolder.outQueueChanged.notify_one();
+}
+
+// ----------------------------------------------------------------------------
+// Function myFlushDuplicates()
+// ----------------------------------------------------------------------------
+
+// exact duplicates are not searched (see collapseDuplicateQueries()); to keep them at their position in the output,
+// a chunk that stands for their records is handed to the writer thread once all queries before them are written
+template <typename TLH>
+inline void
+myFlushDuplicates(TLH & lH, uint64_t const untilQry)
+{
+    if (lH.gH.qryIsDup.empty())
+        return;
+
+    for (; lH.nextDupQry < untilQry; ++lH.nextDupQry)
+    {
+        if (!lH.gH.qryIsDup[lH.nextDupQry])
+            continue;
+
+        if (!empty(lH.outBuffer)) // records before the duplicate
+        {
+            OutputChunk chunk;
+            chunk.block = lH.i;
+            swap(chunk.buffer, lH.outBuffer);
+            myPushChunk(lH.gH, std::move(chunk));
+        }
+
+        OutputChunk chunk;
+        chunk.block     = lH.i;
+        chunk.duplicate = lH.nextDupQry;
+        myPushChunk(lH.gH, std::move(chunk));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Function myFlushRecords()
+// ----------------------------------------------------------------------------
+
+// hand the records formatted by this thread to the writer thread, lastOfBlock must be set exactly once per block
+template <typename TLH>
+inline void
+myFlushRecords(TLH & lH, bool const lastOfBlock)
+{
+    if (lastOfBlock) // duplicates after the last record of the block
+        myFlushDuplicates(lH, lH.indexEndQry / qNumFrames(TLH::blastProgram));
+
+    if (empty(lH.outBuffer) && !lastOfBlock)
+        return;
+
+    OutputChunk chunk;
+    chunk.block = lH.i;
+    chunk.last  = lastOfBlock;
+    swap(chunk.buffer, lH.outBuffer);
+    myPushChunk(lH.gH, std::move(chunk));
 }
 
 // ----------------------------------------------------------------------------
 // Function myWriteRecord()
 // ----------------------------------------------------------------------------
 
+// format the record into buffer
 template <typename TLH, typename TRecord>
 inline void
-myWriteRecord(TLH & lH, TRecord const & record)
+myWriteRecord(TLH & lH, TRecord const & record, typename TLH::TGlobalHolder::TOutBuffer & buffer)
 {
     using TGH = typename TLH::TGlobalHolder;
     if (lH.options.outFileFormat == 0) // BLAST
     {
-        SEQAN_OMP_PRAGMA(critical(filewrite))
-        {
-            writeRecord(lH.gH.outfile, record);
-        }
+        writeRecord(buffer, lH.outContext, record, typename TGH::TOutFormat());
     } else // SAM or BAM
     {
         // convert multi-match blast-record to multiple SAM/BAM-Records
@@ -668,14 +927,23 @@ myWriteRecord(TLH & lH, TRecord const & record)
 
         bamRecords.front().flag -= BAM_FLAG_SECONDARY; // remove BAM_FLAG_SECONDARY for first
 
-        SEQAN_OMP_PRAGMA(critical(filewrite))
-        {
-            for (auto & r : bamRecords)
-                writeRecord(lH.gH.outfileBam, r);
-        }
+        for (auto & r : bamRecords)
+            write(buffer, r, lH.outContextBam, lH.gH.outfileBam.format);
     }
 }
 
+// format the record into the thread's buffer
+template <typename TLH, typename TRecord>
+inline void
+myWriteRecord(TLH & lH, TRecord const & record)
+{
+    myWriteRecord(lH, record, lH.outBuffer);
+
+    // don't let a single block accumulate too much output
+    if (length(lH.outBuffer) >= (1ull << 22))
+        myFlushRecords(lH, false);
+}
+
 // ----------------------------------------------------------------------------
 // Function myWriteFooter()
 // ----------------------------------------------------------------------------
@@ -690,4 +958,18 @@ myWriteFooter(TGH & globalHolder, TLambdaOptions const & options)
     }
 }
 
+// ----------------------------------------------------------------------------
+// Function myCloseOutput()
+// ----------------------------------------------------------------------------
+
+template <typename TGH, typename TLambdaOptions>
+inline void
+myCloseOutput(TGH & globalHolder, TLambdaOptions const & options)
+{
+    if (options.outFileFormat == 0) // BLAST
+        close(globalHolder.outfile);
+    else // SAM or BAM
+        close(globalHolder.outfileBam);
+}
+
 #endif // LAMBDA_SEARCH_OUTPUT_H_
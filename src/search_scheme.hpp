@@ -0,0 +1,93 @@
+// ==========================================================================
+//                                  lambda
+// ==========================================================================
+// Copyright (c) 2013-2019, Hannes Hauswedell <h2 @ fsfe.org>
+// Copyright (c) 2016-2019, Knut Reinert and Freie Universität Berlin
+// All rights reserved.
+//
+// This file is part of Lambda.
+//
+// Lambda is Free Software: you can redistribute it and/or modify it
+// under the terms found in the LICENSE[.md|.rst] file distributed
+// together with this file.
+//
+// Lambda is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+// ==========================================================================
+// search_scheme.hpp: search schemes for seeds with errors
+// ==========================================================================
+
+#ifndef LAMBDA_SEARCH_SCHEME_H_
+#define LAMBDA_SEARCH_SCHEME_H_
+
+#include <vector>
+
+// One search of a search scheme (Kucherov et al., 2016): the seed is split into parts that are searched in the given
+// order, errors are allowed while the count stays within the bounds of the current part.
+struct SchemeSearch
+{
+    std::vector<size_t>   pos;          // positions of the seed in the order in which they are searched
+    std::vector<bool>     fwd;          // extend to the right (else to the left)
+    std::vector<unsigned> minErrors;    // bounds on the number of errors after every step
+    std::vector<unsigned> maxErrors;
+};
+
+// On bidirectional indexes the seed is split into K+1 parts and search j starts with part j without errors, which is
+// complete by the pigeonhole principle: if part j is the first part without errors, the j parts before it hold at
+// least j errors, so the parts after it hold at most K-j; these are searched next, then the parts before it. For one
+// error this is the optimum scheme. Unidirectional indexes can only extend to the right, so there is one search and
+// errors are allowed everywhere (or only in the second half for seedHalfExact).
+// The seed must be longer than K (see the check of seed-delta), otherwise there are empty parts; they are skipped.
+inline std::vector<SchemeSearch>
+searchScheme(size_t const seedLength, unsigned const maxErrors, bool const bidirectional, bool const halfExact)
+{
+    std::vector<SchemeSearch> ret;
+
+    if (!bidirectional)
+    {
+        ret.resize(1);
+        for (size_t k = 0; k < seedLength; ++k)
+        {
+            ret[0].pos.push_back(k);
+            ret[0].fwd.push_back(true);
+            ret[0].minErrors.push_back(0);
+            ret[0].maxErrors.push_back((halfExact && (k < seedLength / 2)) ? 0 : maxErrors);
+        }
+        return ret;
+    }
+
+    size_t const nParts = maxErrors + 1;
+    auto partBegin = [&] (size_t const p) { return p * seedLength / nParts; };
+
+    for (size_t j = 0; j < nParts; ++j)
+    {
+        SchemeSearch s;
+        auto addPart = [&] (size_t const p, bool const fwd, unsigned const maxE)
+        {
+            for (size_t k = 0; k < partBegin(p + 1) - partBegin(p); ++k)
+            {
+                s.pos.push_back(fwd ? (partBegin(p) + k) : (partBegin(p + 1) - 1 - k));
+                s.fwd.push_back(fwd);
+                s.minErrors.push_back(0);
+                s.maxErrors.push_back(maxE);
+            }
+        };
+
+        addPart(j, true, 0);
+        for (size_t p = j + 1; p < nParts; ++p)
+            addPart(p, true, maxErrors - j);
+        for (size_t p = j; p > 0; --p)
+            addPart(p - 1, false, maxErrors);
+
+        // hits with fewer errors are found by an earlier search
+        if (!s.pos.empty())
+            s.minErrors.back() = j;
+
+        ret.push_back(std::move(s));
+    }
+    return ret;
+}
+
+#endif // LAMBDA_SEARCH_SCHEME_H_
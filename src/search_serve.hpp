@@ -0,0 +1,204 @@
+// ==========================================================================
+//                                  lambda
+// ==========================================================================
+// Copyright (c) 2013-2019, Hannes Hauswedell <h2 @ fsfe.org>
+// Copyright (c) 2016-2019, Knut Reinert and Freie Universität Berlin
+// All rights reserved.
+//
+// This file is part of Lambda.
+//
+// Lambda is Free Software: you can redistribute it and/or modify it
+// under the terms found in the LICENSE[.md|.rst] file distributed
+// together with this file.
+//
+// Lambda is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+// ==========================================================================
+// search_serve.hpp: socket handling for the persistent search server
+// ==========================================================================
+
+#ifndef LAMBDA_SEARCH_SERVE_H_
+#define LAMBDA_SEARCH_SERVE_H_
+
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <streambuf>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// ============================================================================
+// Classes, structs, enums
+// ============================================================================
+
+// --------------------------------------------------------------------------
+// Class FdStreamBuf -- buffered output to a file descriptor (the client socket)
+// --------------------------------------------------------------------------
+
+class FdStreamBuf : public std::streambuf
+{
+public:
+    explicit FdStreamBuf(int const _fd) : fd(_fd)
+    {
+        setp(buffer, buffer + sizeof(buffer));
+    }
+
+    ~FdStreamBuf()
+    {
+        sync();
+    }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (!_flush())
+            return traits_type::eof();
+
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override
+    {
+        return _flush() ? 0 : -1;
+    }
+
+private:
+    bool _flush()
+    {
+        char const * it = pbase();
+        while (it < pptr())
+        {
+            ssize_t const written = ::send(fd, it, pptr() - it, MSG_NOSIGNAL);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false; // client went away
+            }
+            it += written;
+        }
+        setp(buffer, buffer + sizeof(buffer));
+        return true;
+    }
+
+    int  fd;
+    char buffer[1 << 16];
+};
+
+// ============================================================================
+// Functions
+// ============================================================================
+
+// --------------------------------------------------------------------------
+// Function _serverSignalHandler()
+// --------------------------------------------------------------------------
+
+inline volatile std::sig_atomic_t &
+_serverStopRequested()
+{
+    static volatile std::sig_atomic_t stop = 0;
+    return stop;
+}
+
+inline void
+_serverSignalHandler(int)
+{
+    _serverStopRequested() = 1;
+}
+
+// --------------------------------------------------------------------------
+// Function openServerSocket()
+// --------------------------------------------------------------------------
+
+// returns the file descriptor of a listening unix domain socket at path
+inline int
+openServerSocket(std::string const & path)
+{
+    sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::invalid_argument("The socket path is too long.");
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("Could not create socket: " + std::string(std::strerror(errno)));
+
+    ::unlink(path.c_str()); // remove stale socket of a previous server
+    if ((::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) ||
+        (::listen(fd, 16) != 0))
+    {
+        std::string err = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("Could not listen on socket " + path + ": " + err);
+    }
+
+    // SIGINT and SIGTERM make accept() return, so that the socket file can be removed cleanly
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = _serverSignalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0; // no SA_RESTART
+    sigaction(SIGINT,  &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    return fd;
+}
+
+// --------------------------------------------------------------------------
+// Function acceptClient()
+// --------------------------------------------------------------------------
+
+// returns the file descriptor of the next client or -1 if the server shall stop
+inline int
+acceptClient(int const serverFd)
+{
+    while (!_serverStopRequested())
+    {
+        int fd = ::accept(serverFd, nullptr, nullptr);
+        if (fd >= 0)
+            return fd;
+        if (errno != EINTR)
+            throw std::runtime_error("Error accepting connection: " + std::string(std::strerror(errno)));
+    }
+    return -1;
+}
+
+// --------------------------------------------------------------------------
+// Function receiveAll()
+// --------------------------------------------------------------------------
+
+// read until the client shuts down its writing end; fails if the server is asked to stop meanwhile, so that a client
+// that never finishes sending cannot keep it alive (the signal interrupts recv(), see openServerSocket())
+inline bool
+receiveAll(std::string & buffer, int const fd)
+{
+    char chunk[1 << 16];
+    buffer.clear();
+    while (true)
+    {
+        ssize_t const got = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (got == 0)
+            return true;
+        if (got < 0)
+        {
+            if ((errno == EINTR) && !_serverStopRequested())
+                continue;
+            return false;
+        }
+        buffer.append(chunk, got);
+    }
+}
+
+#endif // LAMBDA_SEARCH_SERVE_H_
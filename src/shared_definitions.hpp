@@ -87,21 +87,38 @@ struct SAValue<StringSet<String<TSpec1, TSpec2>, TSpec3> >
     typedef Pair<SizeTypeNum_<TSpec1>, SizeTypePos_<TSpec1>, Pack> Type;
 };
 
+// the fibres of an index are memory-mapped iff its text is
+template <typename TString>
+struct LambdaStorageSpec
+{
+    using Type    = Alloc<>;
+};
+
+template <typename TValue, typename TConfig>
+struct LambdaStorageSpec<String<TValue, MMap<TConfig>>>
+{
+    using Type    = MMap<>;
+};
+
+template <typename THost, typename TSpec>
+struct LambdaStorageSpec<ModifiedString<THost, TSpec>> : LambdaStorageSpec<THost>
+{};
+
 template <typename TString, typename TSpec>
 struct DefaultIndexStringSpec<StringSet<TString, TSpec>>
 {
-#if !defined(LAMBDA_INDEXER) && defined(LAMBDA_MMAPPED_DB)
-    using Type    = MMap<>;
-#else
-    using Type    = Alloc<>;
-#endif
+    using Type    = typename LambdaStorageSpec<TString>::Type;
 };
 
+// spec of our Bam output file, the name store refers to the (possibly memory-mapped) subject ids
+template <typename TStringSpec = Alloc<>>
+struct LambdaBamSpec
+{};
+
 // our custom Bam Overload
-template <typename TDirection, typename TStorageSpec>
-struct FormattedFileContext<FormattedFile<Bam, TDirection, BlastTabular>, TStorageSpec>
+template <typename TDirection, typename TStringSpec, typename TStorageSpec>
+struct FormattedFileContext<FormattedFile<Bam, TDirection, LambdaBamSpec<TStringSpec>>, TStorageSpec>
 {
-    typedef typename DefaultIndexStringSpec<StringSet<void, void>>::Type TStringSpec; // see above
     typedef StringSet<Segment<String<char, TStringSpec>, InfixSegment> > TNameStore;
     typedef NameStoreCache<TNameStore>                                   TNameStoreCache;
     typedef BamIOContext<TNameStore, TNameStoreCache, TStorageSpec>      Type;
@@ -109,32 +126,55 @@ struct FormattedFileContext<FormattedFile<Bam, TDirection, BlastTabular>, TStora
 
 }
 
-// Index Specs
+// Index Specs, TAlloc_ is MMap<> when searching memory-mapped (see --db-storage)
+template <typename TAlloc_ = Alloc<>>
 struct LambdaFMIndexConfig
 {
     using LengthSum = size_t;
-#if !defined(LAMBDA_INDEXER) && defined(LAMBDA_MMAPPED_DB)
-    using TAlloc    = MMap<>;
-#else
-    using TAlloc    = Alloc<>;
-#endif
+    using TAlloc    = TAlloc_;
 
     using Bwt       = Levels<void, LevelsRDConfig<LengthSum, TAlloc, 3, 3> >;
     using Sentinels = Levels<void, LevelsRDConfig<LengthSum, TAlloc> >;
 
+    // only a default, the sampling rate is chosen at index creation (see --sa-sampling) and
+    // locating does not depend on it
     static const unsigned SAMPLING = 10;
 };
 
-struct LambdaFMIndexConfigInBi : LambdaFMIndexConfig
+template <typename TAlloc_ = Alloc<>>
+struct LambdaFMIndexConfigInBi : LambdaFMIndexConfig<TAlloc_>
 {
-    using Bwt       = Levels<void, LevelsPrefixRDConfig<LengthSum, TAlloc, 3, 3> >;
+    using Bwt       = Levels<void, LevelsPrefixRDConfig<size_t, TAlloc_, 3, 3> >;
 };
 
-template <typename TSpec = void>
-using TFMIndex = FMIndex<TSpec, LambdaFMIndexConfig>;
+template <typename TSpec = void, typename TAlloc = Alloc<>>
+using TFMIndex = FMIndex<TSpec, LambdaFMIndexConfig<TAlloc>>;
+
+template <typename TSpec = void, typename TAlloc = Alloc<>>
+using TFMIndexInBi = FMIndex<TSpec, LambdaFMIndexConfigInBi<TAlloc>>;
+
+// storage of the subject sequences and ids that belong to an index spec
+template <typename TIndexSpec>
+struct LambdaIndexStorage
+{
+    using Type = Alloc<>;
+};
+
+template <typename TSpec, typename TAlloc>
+struct LambdaIndexStorage<FMIndex<TSpec, LambdaFMIndexConfig<TAlloc>>>
+{
+    using Type = TAlloc;
+};
+
+template <typename TSpec, typename TAlloc>
+struct LambdaIndexStorage<FMIndex<TSpec, LambdaFMIndexConfigInBi<TAlloc>>>
+{
+    using Type = TAlloc;
+};
 
-template <typename TSpec = void>
-using TFMIndexInBi = FMIndex<TSpec, LambdaFMIndexConfigInBi>;
+template <typename TSpec>
+struct LambdaIndexStorage<BidirectionalIndex<TSpec>> : LambdaIndexStorage<TSpec>
+{};
 
 // lazy...
 template <typename TString>
@@ -23,7 +23,12 @@
 #define LAMBDA_SHARED_MISC_H_
 
 #include <unistd.h>
+#include <array>
+#include <cmath>
+#include <exception>
+#include <istream>
 #include <locale>
+#include <streambuf>
 #include <type_traits>
 #include <forward_list>
 #include <sys/sysctl.h>
@@ -33,6 +38,7 @@
 #include <seqan/index.h>
 #include <seqan/align.h>
 #include <seqan/blast.h>
+#include <seqan/translation.h>
 
 using namespace seqan;
 
@@ -98,6 +104,240 @@ printProgressBar(uint64_t & lastPercent, uint64_t curPerc)
     }
 }
 
+// ----------------------------------------------------------------------------
+// Function myTranslateSixFrame()
+// ----------------------------------------------------------------------------
+
+inline unsigned
+_codonIndex(Dna5 const c1, Dna5 const c2, Dna5 const c3)
+{
+    return 25 * ordValue(c1) + 5 * ordValue(c2) + ordValue(c3);
+}
+
+// Tables for all 5^3 codons, computed once with SeqAn's translate() so the semantics are identical. The second
+// table holds the amino acid of the reverse complement of the codon.
+inline void
+_codonTables(std::array<AminoAcid, 125> & fwd, std::array<AminoAcid, 125> & rev, GeneticCodeSpec const geneticCode)
+{
+    static constexpr char const * dna5 = "ACGTN";
+    StringSet<String<Dna5>> codons;
+    resize(codons, 1);
+    for (unsigned i = 0; i < 125; ++i)
+    {
+        appendValue(codons[0], Dna5(dna5[i / 25]));
+        appendValue(codons[0], Dna5(dna5[(i / 5) % 5]));
+        appendValue(codons[0], Dna5(dna5[i % 5]));
+    }
+
+    StringSet<String<AminoAcid>> aas;
+    translate(aas, codons, SINGLE_FRAME, geneticCode);
+
+    auto compl5 = [] (unsigned const c) { return (c == 4) ? 4 : 3 - c; };
+    for (unsigned i = 0; i < 125; ++i)
+    {
+        fwd[i] = aas[0][i];
+        rev[i] = aas[0][25 * compl5(i % 5) + 5 * compl5((i / 5) % 5) + compl5(i / 25)];
+    }
+}
+
+// Six-frame translation of a concat-direct set of Dna5 sequences; same layout as SeqAn's translate(..., SIX_FRAME,
+// ...), i.e. three forward and then three reverse-complement frames per sequence. Every amino acid is a single lookup
+// into a table, the reverse complement is never built and the sequences are processed in parallel.
+template <typename TSpec1, typename TSpec2>
+inline void
+myTranslateSixFrame(TCDStringSet<String<AminoAcid, TSpec1>>         & target,
+                    TCDStringSet<String<Dna5, TSpec2>>        const & source,
+                    GeneticCodeSpec                           const   geneticCode)
+{
+    std::array<AminoAcid, 125> fwd;
+    std::array<AminoAcid, 125> rev;
+    _codonTables(fwd, rev, geneticCode);
+
+    uint64_t const n = length(source);
+    clear(target);
+    resize(target.limits, 6 * n + 1, Exact());
+    target.limits[0] = 0;
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        uint64_t const len = length(source[i]);
+        for (uint64_t f = 0; f < 6; ++f)
+            target.limits[6 * i + f + 1] = target.limits[6 * i + f] + ((len > f % 3) ? (len - f % 3) / 3 : 0);
+    }
+    resize(target.concat, back(target.limits), Exact());
+
+    auto const sBeg = begin(source.concat, Standard());
+    auto const tBeg = begin(target.concat, Standard());
+
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic, 64))
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        auto const s = sBeg + source.limits[i];
+        uint64_t const len = source.limits[i + 1] - source.limits[i];
+
+        for (uint64_t f = 0; f < 3; ++f)
+        {
+            auto const t = tBeg + target.limits[6 * i + f];
+            auto const r = tBeg + target.limits[6 * i + 3 + f];
+            uint64_t const nCodons = target.limits[6 * i + f + 1] - target.limits[6 * i + f];
+
+            for (uint64_t k = 0; k < nCodons; ++k)
+                t[k] = fwd[_codonIndex(s[f + 3 * k], s[f + 3 * k + 1], s[f + 3 * k + 2])];
+
+            // frame f of the reverse complement reads the source backwards, starting f positions before its end
+            uint64_t const e = len - f;
+            for (uint64_t k = 0; k < nCodons; ++k)
+                r[k] = rev[_codonIndex(s[e - 3 * k - 3], s[e - 3 * k - 2], s[e - 3 * k - 1])];
+        }
+    }
+}
+
+// other alphabets
+template <typename TTarget, typename TSource>
+inline void
+myTranslateSixFrame(TTarget & target, TSource const & source, GeneticCodeSpec const geneticCode)
+{
+    translate(target, source, SIX_FRAME, geneticCode);
+}
+
+// ============================================================================
+// Low-complexity masking
+// ============================================================================
+
+// ----------------------------------------------------------------------------
+// Function maskSeg()
+// ----------------------------------------------------------------------------
+
+// SEG (Wootton and Federhen, 1993) without the final optimisation of segments: windows whose complexity (Shannon
+// entropy of the composition in bits) is at most locut trigger the masking, which is extended over the neighbouring
+// windows with a complexity of at most hicut.
+template <typename TSeq, typename TMask>
+inline void
+maskSeg(TSeq const & seq,
+        TMask && mask,
+        unsigned const window = 12,
+        double const locut = 2.2,
+        double const hicut = 2.5)
+{
+    using TAlph = typename Value<TSeq>::Type;
+
+    uint64_t const len = length(seq);
+    if (len < window)
+        return;
+    uint64_t const nWindows = len - window + 1;
+
+    // the entropy is log2(window) - sum(c * log2(c)) / window over the counts c, the sum is kept up-to-date
+    std::vector<double> cLogC(window + 1, 0.0);
+    for (unsigned c = 1; c <= window; ++c)
+        cLogC[c] = c * std::log2(c);
+
+    std::array<unsigned, ValueSize<TAlph>::VALUE> counts{};
+    double sum = 0;
+    auto update = [&] (unsigned const o, int const diff)
+    {
+        sum -= cLogC[counts[o]];
+        counts[o] += diff;
+        sum += cLogC[counts[o]];
+    };
+
+    std::vector<double> entropy(nWindows);
+    for (uint64_t j = 0; j < window; ++j)
+        update(ordValue(seq[j]), 1);
+    for (uint64_t w = 0; w < nWindows; ++w)
+    {
+        if (w > 0)
+        {
+            update(ordValue(seq[w - 1]), -1);
+            update(ordValue(seq[w + window - 1]), 1);
+        }
+        entropy[w] = std::log2(window) - sum / window;
+    }
+
+    for (uint64_t w = 0; w < nWindows; ++w)
+    {
+        if (entropy[w] > locut)
+            continue;
+
+        uint64_t b = w;
+        while ((b > 0) && (entropy[b - 1] <= hicut))
+            --b;
+        uint64_t e = w;
+        while ((e + 1 < nWindows) && (entropy[e + 1] <= hicut))
+            ++e;
+
+        for (uint64_t p = b; p < e + window; ++p)
+            mask[p] = true;
+        w = e;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Function maskDust()
+// ----------------------------------------------------------------------------
+
+// DUST (Morgulis et al., 2006) without the search for the best sub-interval: windows whose triplet score
+// sum(c * (c - 1) / 2) / (l - 1) exceeds the level are masked, where c are the counts of the l triplets in the window
+// (triplets with N are not counted).
+template <typename TSeq, typename TMask>
+inline void
+maskDust(TSeq const & seq,
+         TMask && mask,
+         unsigned const window = 64,
+         unsigned const level = 20)
+{
+    uint64_t const len = length(seq);
+    if (len < window)
+        return;
+    unsigned const nTriplets = window - 2;
+
+    auto triplet = [&seq] (uint64_t const j) -> int
+    {
+        unsigned const a = ordValue(seq[j]);
+        unsigned const b = ordValue(seq[j + 1]);
+        unsigned const c = ordValue(seq[j + 2]);
+        return ((a < 4) && (b < 4) && (c < 4)) ? static_cast<int>((a << 4) | (b << 2) | c) : -1;
+    };
+
+    std::array<unsigned, 64> counts{};
+    uint64_t score = 0; // the numerator, kept up-to-date
+    auto add    = [&] (int const t) { if (t >= 0) score += counts[t]++; };
+    auto remove = [&] (int const t) { if (t >= 0) score -= --counts[t]; };
+
+    for (uint64_t j = 0; j < nTriplets; ++j)
+        add(triplet(j));
+
+    uint64_t maskedUntil = 0;
+    for (uint64_t w = 0; w + window <= len; ++w)
+    {
+        if (w > 0)
+        {
+            remove(triplet(w - 1));
+            add(triplet(w + nTriplets - 1));
+        }
+
+        if (score > static_cast<uint64_t>(level) * (nTriplets - 1))
+        {
+            for (uint64_t p = std::max(w, maskedUntil); p < w + window; ++p)
+                mask[p] = true;
+            maskedUntil = w + window;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Function maskLowComplexity()
+// ----------------------------------------------------------------------------
+
+// SEG for protein, DUST for nucleotide sequences
+template <typename TSeq, typename TMask>
+inline void
+maskLowComplexity(TSeq const & seq, TMask && mask)
+{
+    if (std::is_same<typename Value<TSeq>::Type, Dna5>::value)
+        maskDust(seq, mask);
+    else
+        maskSeg(seq, mask);
+}
+
 
 AlphabetEnum detectSeqFileAlphabet(std::string const & path)
 {
@@ -143,7 +383,8 @@ inline void
 _myReadRecordsImpl(TCDStringSet<String<char>> & meta,
                    TSeqStringSet & seq,
                    FormattedFile<Fastq, Input, TSpec> & file,
-                   TRunnable && runnable)
+                   TRunnable && runnable,
+                   uint64_t const maxRecords)
 {
     typedef typename SeqFileBuffer_<TSeqStringSet, TSpec>::Type TSeqBuffer;
 
@@ -154,7 +395,7 @@ _myReadRecordsImpl(TCDStringSet<String<char>> & meta,
     swapPtr(seqBuffer.data_end, context(file).buffer[1].data_end);
     seqBuffer.data_capacity = context(file).buffer[1].data_capacity;
 
-    for (uint64_t count = 0; !atEnd(file); ++count) // count not used for abort condition
+    for (uint64_t count = 0; (count < maxRecords) && !atEnd(file); ++count)
     {
         readRecord(context(file).buffer[0], seqBuffer, file);
 
@@ -180,15 +421,16 @@ template <typename TSpec1,
           typename TFile,
           typename TRunnable>
 void
-myReadRecords(TCDStringSet<String<char, TSpec1>> & ids,
-              TCDStringSet<String<Dna5, TSpec2>> & seqs,
-              TFile                              & file,
-              TRunnable                         && runnable)
+_myReadRecordsConvert(TCDStringSet<String<char, TSpec1>> & ids,
+                      TCDStringSet<String<Dna5, TSpec2>> & seqs,
+                      TFile                              & file,
+                      TRunnable                         && runnable,
+                      uint64_t const                       maxRecords)
 {
     TCDStringSet<String<Iupac>> tmpSeqs; // all IUPAC nucleic acid characters are valid input
     try
     {
-        _myReadRecordsImpl(ids, tmpSeqs, file, std::forward<TRunnable>(runnable));
+        _myReadRecordsImpl(ids, tmpSeqs, file, std::forward<TRunnable>(runnable), maxRecords);
     }
     catch(ParseError const & e)
     {
@@ -209,14 +451,15 @@ template <typename TSpec1,
           typename TFile,
           typename TRunnable>
 void
-myReadRecords(TCDStringSet<String<char, TSpec1>>       & ids,
-              TCDStringSet<String<AminoAcid, TSpec2>>  & seqs,
-              TFile                                    & file,
-              TRunnable                               && runnable)
+_myReadRecordsConvert(TCDStringSet<String<char, TSpec1>>       & ids,
+                      TCDStringSet<String<AminoAcid, TSpec2>>  & seqs,
+                      TFile                                    & file,
+                      TRunnable                               && runnable,
+                      uint64_t const                             maxRecords)
 {
     try
     {
-        _myReadRecordsImpl(ids, seqs, file, std::forward<TRunnable>(runnable));
+        _myReadRecordsImpl(ids, seqs, file, std::forward<TRunnable>(runnable), maxRecords);
     }
     catch(ParseError const & e)
     {
@@ -226,7 +469,17 @@ myReadRecords(TCDStringSet<String<char, TSpec1>>       & ids,
         err += "\nMake sure that the file is standards compliant.\n";
         throw std::runtime_error(err);
     }
+}
 
+template <typename TSpec2>
+void
+_myCheckRecords(TCDStringSet<String<Dna5, TSpec2>> const & /**/)
+{}
+
+template <typename TSpec2>
+void
+_myCheckRecords(TCDStringSet<String<AminoAcid, TSpec2>> const & seqs)
+{
     if (length(seqs) > 0)
     {
         // warn if sequences look like DNA
@@ -236,6 +489,22 @@ myReadRecords(TCDStringSet<String<char, TSpec1>>       & ids,
     }
 }
 
+template <typename TSpec1,
+          typename TAlph,
+          typename TSpec2,
+          typename TFile,
+          typename TRunnable>
+void
+myReadRecords(TCDStringSet<String<char, TSpec1>>   & ids,
+              TCDStringSet<String<TAlph, TSpec2>>  & seqs,
+              TFile                                & file,
+              TRunnable                           && runnable,
+              uint64_t const                         maxRecords = std::numeric_limits<uint64_t>::max())
+{
+    _myReadRecordsConvert(ids, seqs, file, std::forward<TRunnable>(runnable), maxRecords);
+    _myCheckRecords(seqs);
+}
+
 template <typename TSpec1,
           typename TCharSpec,
           typename TSpec2,
@@ -248,6 +517,161 @@ myReadRecords(TCDStringSet<String<char, TSpec1>>       & ids,
     myReadRecords(ids, seqs, file, [] (auto const &, uint64_t const) {});
 }
 
+// ----------------------------------------------------------------------------
+// Parallel Sequence loading
+// ----------------------------------------------------------------------------
+
+// read-only stream over memory that is owned elsewhere
+class MemStreamBuf_ : public std::streambuf
+{
+public:
+    MemStreamBuf_(char const * b, char const * e)
+    {
+        setg(const_cast<char *>(b), const_cast<char *>(b), const_cast<char *>(e));
+    }
+};
+
+// beginning of the first record that starts at or after pos
+inline size_t
+_nextRecordStart(std::string const & buf, size_t pos, bool const isFastq)
+{
+    if ((pos > 0) && (pos < buf.size()) && (buf[pos - 1] != '\n')) // go to beginning of next line
+    {
+        pos = buf.find('\n', pos);
+        pos = (pos == std::string::npos) ? buf.size() : pos + 1;
+    }
+
+    while (pos < buf.size())
+    {
+        if (!isFastq && (buf[pos] == '>'))
+            return pos;
+
+        if (isFastq && (buf[pos] == '@'))
+        {
+            // quality lines may start with '@', too, but then the line after the next doesn't start with '+'
+            size_t l = buf.find('\n', pos);
+            if (l != std::string::npos)
+                l = buf.find('\n', l + 1);
+            if ((l != std::string::npos) && (l + 1 < buf.size()) && (buf[l + 1] == '+'))
+                return pos;
+        }
+
+        pos = buf.find('\n', pos);
+        if (pos == std::string::npos)
+            return buf.size();
+        ++pos;
+    }
+    return buf.size();
+}
+
+// concatenate the parts into target, each part's data is copied by a different thread
+template <typename TString>
+inline void
+_concatParallel(TCDStringSet<TString> & target, std::vector<TCDStringSet<TString>> & parts)
+{
+    std::vector<uint64_t> seqOffsets(parts.size() + 1, 0);
+    std::vector<uint64_t> charOffsets(parts.size() + 1, 0);
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        seqOffsets[i + 1]  = seqOffsets[i]  + length(parts[i]);
+        charOffsets[i + 1] = charOffsets[i] + length(parts[i].concat);
+    }
+
+    clear(target);
+    resize(target.concat, charOffsets.back(), Exact());
+    resize(target.limits, seqOffsets.back() + 1, Exact());
+
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic))
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        std::copy(begin(parts[i].concat, Standard()),
+                  end(parts[i].concat, Standard()),
+                  begin(target.concat, Standard()) + charOffsets[i]);
+        for (size_t j = 0; j < length(parts[i]); ++j)
+            target.limits[seqOffsets[i] + j] = parts[i].limits[j] + charOffsets[i];
+        clear(parts[i]);
+    }
+    back(target.limits) = charOffsets.back();
+}
+
+// Reads the whole (possibly compressed) file into memory, splits it at record boundaries and parses the parts in
+// parallel. Decompression happens before, in parallel if the file is bgzf-compressed (done by SeqAn's stream).
+// Returns false (and reads nothing) if the file is neither FASTA nor FASTQ.
+template <typename TSpec1,
+          typename TAlph,
+          typename TSpec2>
+bool
+myReadRecordsParallel(TCDStringSet<String<char, TSpec1>>   & ids,
+                      TCDStringSet<String<TAlph, TSpec2>>  & seqs,
+                      std::string                    const & path,
+                      unsigned                       const   threads)
+{
+    std::string buf;
+    {
+        VirtualStream<char, Input> stream;
+        if (!open(stream, path.c_str()))
+            throw std::runtime_error("Could not open " + path + ".");
+
+        std::vector<char> block(1 << 20);
+        while (stream.read(block.data(), block.size()) || (stream.gcount() > 0))
+            buf.append(block.data(), stream.gcount());
+    }
+
+    size_t const firstChar = buf.find_first_not_of(" \t\r\n");
+    if ((firstChar == std::string::npos) || ((buf[firstChar] != '>') && (buf[firstChar] != '@')))
+        return false;
+    bool const isFastq = (buf[firstChar] == '@');
+
+    // more parts than threads to even out differences in record density
+    uint64_t const nTargets = 4 * std::max(threads, 1u);
+    std::vector<size_t> starts{0};
+    for (uint64_t k = 1; k < nTargets; ++k)
+    {
+        size_t const s = _nextRecordStart(buf, (buf.size() * k) / nTargets, isFastq);
+        if (s > starts.back())
+            starts.push_back(s);
+    }
+    if (starts.back() != buf.size())
+        starts.push_back(buf.size());
+    size_t const nParts = starts.size() - 1;
+
+    std::vector<TCDStringSet<String<char, TSpec1>>>  partIds(nParts);
+    std::vector<TCDStringSet<String<TAlph, TSpec2>>> partSeqs(nParts);
+    std::vector<std::exception_ptr>                  errors(nParts);
+
+    SEQAN_OMP_PRAGMA(parallel for schedule(dynamic) num_threads(threads))
+    for (size_t i = 0; i < nParts; ++i)
+    {
+        try
+        {
+            MemStreamBuf_ streamBuf(buf.data() + starts[i], buf.data() + starts[i + 1]);
+            std::istream in(&streamBuf);
+            FormattedFile<Fastq, Input> file;
+            if (!(isFastq ? open(file, in, Fastq()) : open(file, in, Fasta())))
+                throw std::runtime_error("Could not parse " + path + ".");
+
+            _myReadRecordsConvert(partIds[i], partSeqs[i], file, [] (auto const &, uint64_t const) {},
+                                  std::numeric_limits<uint64_t>::max());
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    }
+
+    for (auto const & e : errors)
+        if (e)
+            std::rethrow_exception(e);
+
+    std::string().swap(buf); // free the raw data before concatenating
+
+    _concatParallel(ids, partIds);
+    _concatParallel(seqs, partSeqs);
+
+    _myCheckRecords(seqs);
+    return true;
+}
+
 // ----------------------------------------------------------------------------
 // print if certain verbosity is set
 // ----------------------------------------------------------------------------
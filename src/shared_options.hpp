@@ -176,6 +176,8 @@ struct SharedOptions
     std::string indexDir;
 
     DbIndexType dbIndexType;
+    bool        dbMMap          = false; // memory-map the database instead of reading it into memory
+    unsigned    saSampling      = 10;    // every n-th text position is sampled in the FM index's suffix array
 
     AlphabetEnum subjOrigAlphabet;
     AlphabetEnum transAlphabet;
@@ -0,0 +1,62 @@
+#!/bin/sh
+
+# Searching many queries together (multiple queries per block) must give the same output as searching every query
+# on its own (one query per block).
+
+errorout()
+{
+    echo $1 #> /dev/stderr
+    [ "$MYTMP" = "" ] || rm -r "${MYTMP}"
+    exit 1
+}
+
+[ $# -ne 4 ] && exit 1
+
+SRCDIR=$1
+BINDIR=$2
+CMD=$3
+DI=$4
+
+# check existence of commands
+which gunzip mktemp diff cat awk > /dev/null
+[ $? -eq 0 ] || errorout "Not all required programs found. Needs: gunzip mktemp diff cat awk"
+
+ALPH=prot
+MKINDEX=mkindexp
+case "$CMD" in "searchn")
+    ALPH=nucl
+    MKINDEX=mkindexn
+    ;;
+esac
+
+MYTMP="$(mktemp -q -d -t "$(basename "$0").XXXXXX" 2>/dev/null || mktemp -q -d)"
+[ $? -eq 0 ] || errorout "Could not create tmp"
+
+cd "$MYTMP"
+[ $? -eq 0 ] || errorout "Could not cd to tmp"
+
+gunzip < "${SRCDIR}/tests/db_${ALPH}.fasta.gz" > db.fasta
+[ $? -eq 0 ] || errorout "Could not unzip database file"
+
+${BINDIR}/bin/lambda2 ${MKINDEX} -d db.fasta --db-index-type ${DI}
+[ $? -eq 0 ] || errorout "Could not run the indexer"
+
+awk '/^>/ { ++n } n > 40 { exit } { print }' db.fasta > queries.fasta
+[ -s queries.fasta ] || errorout "Could not create queries.fasta"
+
+# few matches per query, so that the sorting for abundant queries is used, too
+SEARCHARGS="-i db.fasta.lambda -m xdrop -n 10 --version-to-outputfile off"
+
+${BINDIR}/bin/lambda2 ${CMD} ${SEARCHARGS} -q queries.fasta -t 4 -o all.m8
+[ $? -eq 0 ] || errorout "Search failed."
+
+awk '/^>/ { f = sprintf("single_%04d.fasta", ++n) } { print > f }' queries.fasta
+for Q in single_*.fasta; do
+    ${BINDIR}/bin/lambda2 ${CMD} ${SEARCHARGS} -q ${Q} -t 1 -o ${Q%.fasta}.m8
+    [ $? -eq 0 ] || errorout "Search failed for ${Q}."
+done
+cat single_*.m8 > singles.m8
+
+diff all.m8 singles.m8 > /dev/null || errorout "$(diff -u all.m8 singles.m8 | head -n 20)"
+
+rm -r "${MYTMP}"
@@ -0,0 +1,133 @@
+// ==========================================================================
+//                                  lambda
+// ==========================================================================
+// Copyright (c) 2013-2019, Hannes Hauswedell <h2 @ fsfe.org>
+// Copyright (c) 2016-2019, Knut Reinert and Freie Universität Berlin
+// All rights reserved.
+//
+// This file is part of Lambda.
+//
+// Lambda is Free Software: you can redistribute it and/or modify it
+// under the terms found in the LICENSE[.md|.rst] file distributed
+// together with this file.
+//
+// Lambda is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+// ==========================================================================
+// query_blocks_test.cpp: partitioning of the queries into blocks and their order
+// ==========================================================================
+
+// The blocks have to cover the queries in order, merged blocks have to reach the target cost, and within every group
+// the most expensive blocks have to be scheduled first without moving any block out of its group.
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+#include "../src/search_blocks.hpp"
+
+static int ret = EXIT_SUCCESS;
+
+inline void
+check(bool const condition, char const * const what)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << what << "\n";
+        ret = EXIT_FAILURE;
+    }
+}
+
+inline void
+checkLimits(std::vector<uint64_t> const & limits, uint64_t const nQueries)
+{
+    check(!limits.empty() && (limits.front() == 0) && (limits.back() == nQueries), "blocks cover all queries");
+    check(std::is_sorted(limits.begin(), limits.end()), "blocks are in query order");
+}
+
+inline void
+checkOrder(std::vector<uint64_t> const & blockCosts, uint64_t const groupSize)
+{
+    std::vector<uint64_t> const order = orderQueryBlocks(blockCosts, groupSize);
+    check(order.size() == blockCosts.size(), "every block is scheduled");
+
+    for (uint64_t t = 0; t < order.size(); ++t)
+    {
+        // same group as its position, so no thread runs further ahead of the writer than before
+        check(order[t] / groupSize == t / groupSize, "blocks stay in their group");
+        // within a group, the most expensive blocks come first
+        if ((t % groupSize) != 0)
+            check(blockCosts[order[t - 1]] >= blockCosts[order[t]], "expensive blocks are scheduled first");
+    }
+
+    std::vector<uint64_t> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    for (uint64_t b = 0; b < sorted.size(); ++b)
+        check(sorted[b] == b, "every block is scheduled once");
+}
+
+int main()
+{
+    std::mt19937_64 rng(42);
+
+    for (uint64_t const nQueries : {0, 1, 7, 100, 1000})
+    {
+        std::vector<uint64_t> costs(nQueries);
+        for (uint64_t & c : costs)
+            c = 32 + rng() % 1000;
+        if (nQueries > 0)
+            costs.back() = 30000; // a long query at the end of the file
+
+        // merging
+        for (uint64_t const target : {0, 1, 500, 5000, 100000})
+        {
+            std::vector<uint64_t> const limits = mergeQueryBlocks(costs, target);
+            checkLimits(limits, nQueries);
+            for (uint64_t b = 0; b + 1 < limits.size(); ++b)
+            {
+                uint64_t cost = 0;
+                for (uint64_t q = limits[b]; q < limits[b + 1]; ++q)
+                    cost += costs[q];
+                check(limits[b] < limits[b + 1], "merged blocks are not empty");
+                if (b + 2 < limits.size())
+                    check(cost >= target, "merged blocks reach the target cost");
+                check((cost - costs[limits[b + 1] - 1] < target) || (limits[b + 1] - limits[b] == 1),
+                      "merged blocks stop at the target cost");
+            }
+            if (target == 0)
+                check(limits.size() == nQueries + 1, "a target of 0 gives one block per query");
+
+            // ordering of the merged blocks
+            std::vector<uint64_t> blockCosts;
+            for (uint64_t b = 0; b + 1 < limits.size(); ++b)
+            {
+                blockCosts.push_back(0);
+                for (uint64_t q = limits[b]; q < limits[b + 1]; ++q)
+                    blockCosts.back() += costs[q];
+            }
+            for (uint64_t const groupSize : {1, 8, 32, 100000})
+                checkOrder(blockCosts, groupSize);
+
+            // the long last query starts before every other block of its group
+            if ((target == 0) && (nQueries > 1))
+            {
+                uint64_t const groupSize = 32;
+                std::vector<uint64_t> const order = orderQueryBlocks(blockCosts, groupSize);
+                check(order[(nQueries - 1) / groupSize * groupSize] == nQueries - 1,
+                      "the most expensive block is the first of its group");
+            }
+        }
+
+        // fixed number of blocks (double-indexing)
+        for (uint64_t const nBlocks : {1, 2, 10, 64})
+        {
+            std::vector<uint64_t> const limits = splitQueryBlocks(costs, nBlocks);
+            checkLimits(limits, nQueries);
+            check(limits.size() == nBlocks + 1, "the number of blocks is as given");
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,96 @@
+// ==========================================================================
+//                                  lambda
+// ==========================================================================
+// Copyright (c) 2013-2019, Hannes Hauswedell <h2 @ fsfe.org>
+// Copyright (c) 2016-2019, Knut Reinert and Freie Universität Berlin
+// All rights reserved.
+//
+// This file is part of Lambda.
+//
+// Lambda is Free Software: you can redistribute it and/or modify it
+// under the terms found in the LICENSE[.md|.rst] file distributed
+// together with this file.
+//
+// Lambda is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+// ==========================================================================
+// search_scheme_test.cpp: completeness of the search schemes
+// ==========================================================================
+
+// Every distribution of up to K errors over the seed has to be found by at least one search of the scheme. The
+// searches are walked like in __goDownScheme(), only the positions of the errors matter.
+
+#include <cstdlib>
+#include <iostream>
+
+#include "../src/search_scheme.hpp"
+
+// whether the search reaches the end of the seed with errors at the positions set in errorMask
+inline bool
+finds(SchemeSearch const & search, uint64_t const errorMask)
+{
+    unsigned errors = 0;
+    for (size_t step = 0; step < search.pos.size(); ++step)
+    {
+        bool const isError = (errorMask >> search.pos[step]) & 1;
+        if (isError && (errors >= search.maxErrors[step]))
+            return false;
+        errors += isError;
+        if (errors < search.minErrors[step])
+            return false;
+    }
+    return true;
+}
+
+int main()
+{
+    int ret = EXIT_SUCCESS;
+
+    for (unsigned K = 0; K <= 3; ++K)
+    {
+        for (size_t seedLength = K + 1; seedLength <= 16; ++seedLength)
+        {
+            for (bool const bidirectional : {true, false})
+            {
+                for (bool const halfExact : {false, true})
+                {
+                    std::vector<SchemeSearch> const scheme = searchScheme(seedLength, K, bidirectional, halfExact);
+
+                    for (SchemeSearch const & search : scheme)
+                    {
+                        if (search.pos.size() != seedLength)
+                        {
+                            std::cerr << "Search does not cover the seed: K=" << K << " length=" << seedLength << "\n";
+                            ret = EXIT_FAILURE;
+                        }
+                    }
+
+                    for (uint64_t errorMask = 0; errorMask < (1ull << seedLength); ++errorMask)
+                    {
+                        if (static_cast<unsigned>(__builtin_popcountll(errorMask)) > K)
+                            continue;
+                        // half-exact seeds only allow errors in the second half (the bidirectional scheme ignores it)
+                        if (!bidirectional && halfExact && (errorMask & ((1ull << (seedLength / 2)) - 1)))
+                            continue;
+
+                        bool found = false;
+                        for (SchemeSearch const & search : scheme)
+                            found = found || finds(search, errorMask);
+
+                        if (!found)
+                        {
+                            std::cerr << "Not found: K=" << K << " length=" << seedLength
+                                      << " bidirectional=" << bidirectional << " halfExact=" << halfExact
+                                      << " errors=" << errorMask << "\n";
+                            ret = EXIT_FAILURE;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return ret;
+}